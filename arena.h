@@ -0,0 +1,132 @@
+//Grid Storage
+//Every Owner takes its Layers from one Allocation, each Layer starts on its own Cache Line
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+
+const size_t cacheLine = 64;
+
+//Bytes rounded up to whole Cache Lines, so no two Layers share one
+inline size_t cacheLinePadded(size_t bytes){
+  return (bytes+cacheLine-1)/cacheLine*cacheLine;
+}
+
+//Bytes held per Subsystem, current and at most
+class MemoryLedger {
+  public:
+  void charge(const std::string& subsystem, size_t bytes);
+  void refund(const std::string& subsystem, size_t bytes);
+  void dump(std::ostream& out) const;
+
+  private:
+  struct Account {
+    size_t current = 0;
+    size_t peak = 0;
+  };
+  mutable std::mutex mutex;
+  std::map<std::string, Account> accounts;
+};
+
+MemoryLedger& memoryLedger(){
+  static MemoryLedger ledger;
+  return ledger;
+}
+
+void MemoryLedger::charge(const std::string& subsystem, size_t bytes){
+  std::lock_guard<std::mutex> lock(mutex);
+  Account& a = accounts[subsystem];
+  a.current += bytes;
+  a.peak = std::max(a.peak, a.current);
+}
+
+void MemoryLedger::refund(const std::string& subsystem, size_t bytes){
+  std::lock_guard<std::mutex> lock(mutex);
+  accounts[subsystem].current -= bytes;
+}
+
+void MemoryLedger::dump(std::ostream& out) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  out << std::left << std::setw(18) << "memory" << std::right
+      << std::setw(12) << "current MB" << std::setw(12) << "peak MB" << std::endl;
+  size_t current = 0, peak = 0;
+  for(std::map<std::string, Account>::const_iterator it = accounts.begin(); it != accounts.end(); ++it){
+    out << std::left << std::setw(18) << it->first << std::right << std::fixed << std::setprecision(3)
+        << std::setw(12) << it->second.current/1048576.0 << std::setw(12) << it->second.peak/1048576.0 << std::endl;
+    current += it->second.current;
+    peak += it->second.peak;
+  }
+  out << std::left << std::setw(18) << "total" << std::right << std::fixed << std::setprecision(3)
+      << std::setw(12) << current/1048576.0 << std::setw(12) << peak/1048576.0 << std::endl;
+}
+
+/*
+Bump Allocator over one Block:
+reserve() sizes the Block for everything the Owner will take, layer() hands out zeroed,
+aligned and padded Pieces of it. Nothing is freed on its own, the Block goes at once.
+*/
+class GridArena {
+  public:
+  GridArena() { }
+  explicit GridArena(size_t capacity) { reserve(capacity); }
+  ~GridArena() { release(); }
+  GridArena(const GridArena&) = delete;
+  GridArena& operator=(const GridArena&) = delete;
+
+  //Replaces the Block, Layers handed out before are gone
+  void reserve(size_t capacity);
+  void release();
+
+  //count Elements charged to subsystem, throws std::bad_alloc if the Block is too small
+  template<typename T>
+  T* layer(size_t count, const char* subsystem);
+
+  //Space a Layer takes in the Block
+  template<typename T>
+  static size_t bytes(size_t count) { return cacheLinePadded(count*sizeof(T)); }
+
+  size_t capacity() const { return size; }
+  size_t used() const { return offset; }
+
+  private:
+  unsigned char* base = NULL;
+  size_t size = 0;
+  size_t offset = 0;
+  std::map<std::string, size_t> charges;
+};
+
+void GridArena::reserve(size_t capacity){
+  release();
+  if(capacity == 0) return;
+  void* block = NULL;
+  if(posix_memalign(&block, cacheLine, capacity) != 0) throw std::bad_alloc();
+  base = (unsigned char*)block;
+  size = capacity;
+}
+
+void GridArena::release(){
+  for(std::map<std::string, size_t>::iterator it = charges.begin(); it != charges.end(); ++it)
+    memoryLedger().refund(it->first, it->second);
+  charges.clear();
+  free(base);
+  base = NULL;
+  size = 0;
+  offset = 0;
+}
+
+template<typename T>
+T* GridArena::layer(size_t count, const char* subsystem){
+  const size_t need = bytes<T>(count);
+  if(offset+need > size) throw std::bad_alloc();
+  T* p = (T*)(base+offset);
+  memset(p, 0, need);
+  offset += need;
+  charges[subsystem] += need;
+  memoryLedger().charge(subsystem, need);
+  return p;
+}
@@ -0,0 +1,127 @@
+//Asset Manager
+//All Images are decoded once at Startup and packed into a single Texture
+#include <string>
+#include <vector>
+#include <algorithm>
+
+typedef int AssetHandle;
+
+class AssetManager {
+  public:
+  ~AssetManager();
+
+  //Queue an Image for Packing, returns its Handle (-1 if it failed to load)
+  AssetHandle load(const std::string& path);
+  //Takes Ownership of the Surface
+  AssetHandle add(const std::string& name, SDL_Surface* surface);
+  //Packs everything queued into the Atlas Texture
+  bool pack(SDL_Renderer* gRenderer);
+
+  AssetHandle handle(const std::string& name) const;
+  //False for the Handle of an Image that failed to load
+  bool valid(AssetHandle asset) const { return asset >= 0 && (size_t)asset < assets.size(); }
+  SDL_Texture* texture() const { return atlas; }
+  //Sub-Rectangle of an Asset in Atlas Coordinates, empty for an invalid Handle
+  SDL_Rect source(AssetHandle asset, int x, int y, int w, int h) const;
+  const SDL_Rect& rect(AssetHandle asset) const;
+  int atlasWidth() const { return width; }
+  int atlasHeight() const { return height; }
+
+  private:
+  struct Asset {
+    std::string name;
+    SDL_Surface* surface = NULL;
+    SDL_Rect rect = {0,0,0,0};
+  };
+  std::vector<Asset> assets;
+  SDL_Texture* atlas = NULL;
+  int width = 0;
+  int height = 0;
+};
+
+AssetManager::~AssetManager(){
+  for(size_t i = 0; i<assets.size(); i++)
+    if(assets[i].surface != NULL) SDL_FreeSurface(assets[i].surface);
+  if(atlas != NULL) SDL_DestroyTexture(atlas);
+}
+
+AssetHandle AssetManager::load(const std::string& path){
+  SDL_Surface* surface = IMG_Load(path.c_str());
+  if(surface == NULL){
+    std::cout<<"Couldn't load "<<path<<std::endl;
+    return -1;
+  }
+  return add(path, surface);
+}
+
+AssetHandle AssetManager::add(const std::string& name, SDL_Surface* surface){
+  if(surface == NULL) return -1;
+  Asset asset;
+  asset.name = name;
+  asset.surface = surface;
+  asset.rect.w = surface->w;
+  asset.rect.h = surface->h;
+  assets.push_back(asset);
+  return (AssetHandle)assets.size()-1;
+}
+
+bool AssetManager::pack(SDL_Renderer* gRenderer){
+  //Shelf Packing, tallest Images first
+  std::vector<int> order(assets.size());
+  for(size_t i = 0; i<order.size(); i++) order[i] = (int)i;
+  std::sort(order.begin(), order.end(), [this](int a, int b){ return assets[a].rect.h > assets[b].rect.h; });
+
+  width = 256;
+  for(size_t i = 0; i<assets.size(); i++) width = std::max(width, assets[i].rect.w);
+  int x = 0, y = 0, shelf = 0;
+  for(size_t n = 0; n<order.size(); n++){
+    SDL_Rect& r = assets[order[n]].rect;
+    if(x+r.w > width){
+      x = 0;
+      y += shelf+1;
+      shelf = 0;
+    }
+    r.x = x;
+    r.y = y;
+    x += r.w+1;
+    shelf = std::max(shelf, r.h);
+  }
+  height = y+shelf;
+
+  SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+  if(surface == NULL) return false;
+  for(size_t i = 0; i<assets.size(); i++){
+    SDL_SetSurfaceBlendMode(assets[i].surface, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(assets[i].surface, NULL, surface, &assets[i].rect);
+    //Decoded Pixels are no longer needed once in the Atlas
+    SDL_FreeSurface(assets[i].surface);
+    assets[i].surface = NULL;
+  }
+  if(atlas != NULL) SDL_DestroyTexture(atlas);
+  atlas = SDL_CreateTextureFromSurface(gRenderer, surface);
+  SDL_FreeSurface(surface);
+  if(atlas == NULL) return false;
+  SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_BLEND);
+  return true;
+}
+
+AssetHandle AssetManager::handle(const std::string& name) const {
+  for(size_t i = 0; i<assets.size(); i++)
+    if(assets[i].name == name) return (AssetHandle)i;
+  return -1;
+}
+
+const SDL_Rect& AssetManager::rect(AssetHandle asset) const {
+  static const SDL_Rect empty = {0,0,0,0};
+  return valid(asset) ? assets[asset].rect : empty;
+}
+
+SDL_Rect AssetManager::source(AssetHandle asset, int x, int y, int w, int h) const {
+  SDL_Rect r = {0,0,0,0};
+  if(!valid(asset)) return r;
+  r.x = assets[asset].rect.x+x;
+  r.y = assets[asset].rect.y+y;
+  r.w = w;
+  r.h = h;
+  return r;
+}
@@ -0,0 +1,130 @@
+//Shared-Memory Layout of the live Climate, and the Reader for other Processes
+//Standalone: external Tools include only this Header and link -lrt
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const uint32_t climateShmVersion = 1;
+
+/*
+Segment Layout:
+ClimateShmHeader, then two Slots at slotOffset[s], each
+float Temp[n], float Humidity[n], float Wind[n], uint8 Cloud[n], uint8 Rain[n]
+
+Every Slot is a Seqlock: the Sequence is odd while the Producer writes it.
+The Producer alternates Slots, so a Reader has a whole Day to finish one.
+*/
+struct ClimateShmSlot {
+  std::atomic<uint64_t> sequence;
+  int32_t day;
+  double windDirection[2];
+};
+
+struct ClimateShmHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t gridSize;
+  uint32_t slotCount;
+  uint64_t slotBytes;
+  uint64_t slotOffset[2];
+  //Days published so far, the newest is in Slot (published-1)%2
+  std::atomic<uint64_t> published;
+  ClimateShmSlot slot[2];
+};
+
+inline size_t climateShmSlotBytes(size_t gridSize){
+  const size_t n = gridSize*gridSize;
+  //Keep Slots Cache Line aligned
+  return (n*(3*sizeof(float)+2)+63)/64*64;
+}
+
+inline size_t climateShmHeaderBytes(){
+  return (sizeof(ClimateShmHeader)+63)/64*64;
+}
+
+class ClimateShmReader {
+  public:
+  ~ClimateShmReader(){ close(); }
+
+  //Maps the Segment read-only, false if it doesn't exist or doesn't match this Layout
+  bool open(const char* name){
+    close();
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0) return false;
+    struct stat st;
+    if(fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ClimateShmHeader)){
+      bytes = (size_t)st.st_size;
+      void* mapped = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+      if(mapped != MAP_FAILED) base = (const unsigned char*)mapped;
+    }
+    ::close(fd);
+    if(base == NULL) return false;
+    if(memcmp(header()->magic, "CLSH", 4) != 0 || header()->version != climateShmVersion){
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close(){
+    if(base != NULL) munmap((void*)base, bytes);
+    base = NULL;
+    bytes = 0;
+  }
+
+  size_t gridSize() const { return header()->gridSize; }
+
+  //Pointers straight into the Segment, nothing is copied
+  struct Day {
+    int day = 0;
+    double windDirection[2];
+    const float* temp = NULL;
+    const float* humidity = NULL;
+    const float* wind = NULL;
+    const uint8_t* cloud = NULL;
+    const uint8_t* rain = NULL;
+    int slot = 0;
+    uint64_t sequence = 0;
+  };
+
+  //Newest complete Day, false if nothing was published yet
+  bool latest(Day& d) const {
+    const ClimateShmHeader* h = header();
+    while(true){
+      const uint64_t published = h->published.load(std::memory_order_acquire);
+      if(published == 0) return false;
+      d.slot = (int)((published-1)%2);
+      const ClimateShmSlot& s = h->slot[d.slot];
+      d.sequence = s.sequence.load(std::memory_order_acquire);
+      if(d.sequence & 1) continue;
+      d.day = s.day;
+      d.windDirection[0] = s.windDirection[0];
+      d.windDirection[1] = s.windDirection[1];
+      const size_t n = (size_t)h->gridSize*h->gridSize;
+      const unsigned char* data = base+h->slotOffset[d.slot];
+      d.temp = (const float*)data;
+      d.humidity = d.temp+n;
+      d.wind = d.humidity+n;
+      d.cloud = (const uint8_t*)(d.wind+n);
+      d.rain = d.cloud+n;
+      if(valid(d)) return true;
+    }
+  }
+
+  //True if the Producer hasn't started overwriting the Day, check after reading it
+  bool valid(const Day& d) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return header()->slot[d.slot].sequence.load(std::memory_order_relaxed) == d.sequence;
+  }
+
+  private:
+  const unsigned char* base = NULL;
+  size_t bytes = 0;
+
+  const ClimateShmHeader* header() const { return (const ClimateShmHeader*)base; }
+};
@@ -0,0 +1,156 @@
+//Seasonal Climatologies
+//Mean Temperature, Humidity, Wind, Cloud and Rain per Period of the Year, opt-in through TERRITORY_PERIODS.
+//calcAverage gathers them Row by Row in the same Pass as the annual Averages, no Day is simulated twice.
+//Periods are kept in 16 Bit Fixed Point like fixedpoint.h, Cloud and Rain as 8 Bit Fractions of the Days.
+#include <stdint.h>
+#include <ostream>
+#include <iomanip>
+
+enum SeasonField {
+  SEASON_TEMP,
+  SEASON_HUMIDITY,
+  SEASON_WIND,
+  SEASON_CLOUD,
+  SEASON_RAIN,
+  SEASON_FIELDS
+};
+
+const char* const seasonFieldNames[SEASON_FIELDS] = { "temp", "humidity", "wind", "cloud", "rain" };
+
+//Periods per Year new Worlds keep, TERRITORY_PERIODS=<n> (12 for Months), none unless asked for
+int& seasonPeriods(){
+  static int periods = getenv("TERRITORY_PERIODS") != NULL ? std::min(std::max(atoi(getenv("TERRITORY_PERIODS")), 0), 365) : 0;
+  return periods;
+}
+
+class Climatology {
+  public:
+  Climatology(size_t gridSize, int periods);
+  Climatology(const Climatology&) = delete;
+  Climatology& operator=(const Climatology&) = delete;
+
+  size_t gridSize;
+  int periods;
+  //Bumped whenever calcAverage filled the Periods anew
+  unsigned int revision = 0;
+
+  //Period of a Day of the Year, Periods differ by at most a Day in Length
+  int period(int day) const { return (day%365)*periods/365; }
+  int periodDays(int p) const { return ((p+1)*365+periods-1)/periods-(p*365+periods-1)/periods; }
+  //Period ending with the Day, -1 if it doesn't end one
+  int closing(int day) const { return (day%365 == 364 || period(day) != period(day+1)) ? period(day) : -1; }
+
+  //One Day of one Cell into the running Period
+  void add(size_t cell, float wind, bool rain, bool cloud, float temp, float humidity){
+    sumWind[cell] += wind;
+    sumTemp[cell] += temp;
+    sumHumidity[cell] += humidity;
+    countRain[cell] += rain;
+    countCloud[cell] += cloud;
+  }
+  //Stores the running Period's Means of the Cell and starts the next one
+  void close(size_t cell, int period);
+  //Drops a running Period, calcAverage starts from the first Day
+  void restart();
+
+  //Mean of the Field over the Period at the Cell
+  float value(SeasonField field, int period, size_t cell) const;
+  //Table of the Periods, every Field averaged over the Land Cells
+  void write(std::ostream& out, const unsigned char* sea) const;
+
+  private:
+  GridArena storage;
+  //[period*gridSize*gridSize+cell]
+  uint16_t* temp = nullptr;
+  uint16_t* humidity = nullptr;
+  int16_t* wind = nullptr;
+  uint8_t* cloud = nullptr;
+  uint8_t* rain = nullptr;
+  //The running Period
+  float* sumTemp = nullptr;
+  float* sumHumidity = nullptr;
+  float* sumWind = nullptr;
+  uint16_t* countRain = nullptr;
+  uint16_t* countCloud = nullptr;
+};
+
+Climatology::Climatology(size_t gridSizeIn, int periodsIn) : gridSize(gridSizeIn), periods(periodsIn) {
+  if(periods <= 0) return;
+  const size_t gridSizeSq = gridSize*gridSize;
+  const size_t stored = periods*gridSizeSq;
+  storage.reserve(3*GridArena::bytes<uint16_t>(stored)+2*GridArena::bytes<uint8_t>(stored)
+                 +3*GridArena::bytes<float>(gridSizeSq)+2*GridArena::bytes<uint16_t>(gridSizeSq));
+  temp = storage.layer<uint16_t>(stored, "climatology");
+  humidity = storage.layer<uint16_t>(stored, "climatology");
+  wind = storage.layer<int16_t>(stored, "climatology");
+  cloud = storage.layer<uint8_t>(stored, "climatology");
+  rain = storage.layer<uint8_t>(stored, "climatology");
+  sumTemp = storage.layer<float>(gridSizeSq, "climatology");
+  sumHumidity = storage.layer<float>(gridSizeSq, "climatology");
+  sumWind = storage.layer<float>(gridSizeSq, "climatology");
+  countRain = storage.layer<uint16_t>(gridSizeSq, "climatology");
+  countCloud = storage.layer<uint16_t>(gridSizeSq, "climatology");
+}
+
+void Climatology::close(size_t cell, int p){
+  const float days = (float)periodDays(p);
+  const size_t slot = p*gridSize*gridSize+cell;
+  temp[slot] = toFixed(sumTemp[cell]/days);
+  humidity[slot] = toFixed(sumHumidity[cell]/days);
+  wind[slot] = toFixedWind(sumWind[cell]/days);
+  cloud[slot] = (uint8_t)lrintf(countCloud[cell]*255/days);
+  rain[slot] = (uint8_t)lrintf(countRain[cell]*255/days);
+  sumTemp[cell] = sumHumidity[cell] = sumWind[cell] = 0;
+  countRain[cell] = countCloud[cell] = 0;
+}
+
+void Climatology::restart(){
+  if(periods <= 0) return;
+  const size_t gridSizeSq = gridSize*gridSize;
+  memset(sumTemp, 0, gridSizeSq*sizeof(float));
+  memset(sumHumidity, 0, gridSizeSq*sizeof(float));
+  memset(sumWind, 0, gridSizeSq*sizeof(float));
+  memset(countRain, 0, gridSizeSq*sizeof(uint16_t));
+  memset(countCloud, 0, gridSizeSq*sizeof(uint16_t));
+}
+
+float Climatology::value(SeasonField field, int p, size_t cell) const {
+  const size_t slot = p*gridSize*gridSize+cell;
+  switch(field){
+    case SEASON_TEMP: return fromFixed(temp[slot]);
+    case SEASON_HUMIDITY: return fromFixed(humidity[slot]);
+    case SEASON_WIND: return fromFixedWind(wind[slot]);
+    case SEASON_CLOUD: return cloud[slot]/255.0f;
+    case SEASON_RAIN: return rain[slot]/255.0f;
+    default: return 0;
+  }
+}
+
+void Climatology::write(std::ostream& out, const unsigned char* sea) const {
+  const size_t gridSizeSq = gridSize*gridSize;
+  out << std::left << std::setw(8) << "period" << std::right << std::setw(6) << "days";
+  for(int f = 0; f<SEASON_FIELDS; f++) out << std::setw(10) << seasonFieldNames[f];
+  out << std::endl;
+  for(int p = 0; p<periods; p++){
+    double sum[SEASON_FIELDS] = {0};
+    size_t land = 0;
+    for(size_t cell = 0; cell<gridSizeSq; cell++){
+      if(sea[cell]) continue;
+      land++;
+      for(int f = 0; f<SEASON_FIELDS; f++) sum[f] += value((SeasonField)f, p, cell);
+    }
+    out << std::left << std::setw(8) << p << std::right << std::setw(6) << periodDays(p) << std::fixed << std::setprecision(4);
+    for(int f = 0; f<SEASON_FIELDS; f++) out << std::setw(10) << (land > 0 ? sum[f]/land : 0);
+    out << std::endl;
+  }
+}
+
+//Cells [first, last] of one simulated Day, declared in kernels.h for the Day Kernel
+void accumulateSeason(Climatology* season, int day, size_t first, size_t last,
+                      const float* wind, const bool* rain, const bool* cloud, const float* temp, const float* humidity){
+  const int closing = season->closing(day);
+  for(size_t cell = first; cell<=last; cell++){
+    season->add(cell, wind[cell], rain[cell], cloud[cell], temp[cell], humidity[cell]);
+    if(closing >= 0) season->close(cell, closing);
+  }
+}
@@ -0,0 +1,185 @@
+//Climate Time-Series Export
+//The Simulation Thread only fills preallocated Slots, a Writer Thread does all File I/O
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <stdint.h>
+#include "ring.h"
+
+//Per-Day Aggregates of the Current Climate Maps
+struct ClimateRecord {
+  int day = 0;
+  //Temp, Humidity, Wind
+  float mean[3];
+  float min[3];
+  float max[3];
+  float rainFraction = 0;
+  float cloudFraction = 0;
+  double windDirection[2];
+};
+
+class ClimateExporter {
+  public:
+  //Writes <prefix>.csv, and <prefix>.frames if frameInterval > 0
+  ClimateExporter(const std::string& prefix, size_t gridSize, int frameInterval);
+  ~ClimateExporter();
+
+  //Never blocks: Records or Frames that don't fit are dropped and counted
+  void record(int day, const Climate& climate);
+  size_t dropped() const { return droppedRecords.load()+droppedFrames.load(); }
+
+  private:
+  struct Frame {
+    int day = 0;
+    std::vector<float> temp;
+    std::vector<float> humidity;
+    std::vector<float> wind;
+    std::vector<uint8_t> cloud;
+    std::vector<uint8_t> rain;
+  };
+  static const int frameSlots = 4;
+
+  std::string prefix;
+  size_t gridSize;
+  int frameInterval;
+  SpscRing<ClimateRecord> records;
+  //Frame Slots travel to the Writer and back
+  std::vector<Frame> frames;
+  SpscRing<int> filledFrames;
+  SpscRing<int> freeFrames;
+  std::atomic<size_t> droppedRecords{0};
+  std::atomic<size_t> droppedFrames{0};
+  std::atomic<bool> running{true};
+  std::thread writer;
+
+  void write();
+};
+
+ClimateExporter::ClimateExporter(const std::string& prefixIn, size_t gridSizeIn, int frameIntervalIn) :
+  prefix(prefixIn), gridSize(gridSizeIn), frameInterval(frameIntervalIn),
+  records(4096), filledFrames(frameSlots), freeFrames(frameSlots) {
+  //All Frame Memory is allocated up front
+  if(frameInterval > 0){
+    const size_t gridSizeSq = gridSize*gridSize;
+    frames.resize(frameSlots);
+    for(int i = 0; i<frameSlots; i++){
+      frames[i].temp.resize(gridSizeSq);
+      frames[i].humidity.resize(gridSizeSq);
+      frames[i].wind.resize(gridSizeSq);
+      frames[i].cloud.resize(gridSizeSq);
+      frames[i].rain.resize(gridSizeSq);
+      freeFrames.push(i);
+    }
+  }
+  writer = std::thread(&ClimateExporter::write, this);
+}
+
+ClimateExporter::~ClimateExporter(){
+  running = false;
+  writer.join();
+  if(dropped() > 0)
+    std::cout<<"Climate export dropped "<<droppedRecords.load()<<" records and "<<droppedFrames.load()<<" frames"<<std::endl;
+}
+
+void ClimateExporter::record(int day, const Climate& climate){
+  const size_t gridSizeSq = gridSize*gridSize;
+  const float* maps[3] = { climate.TempMap, climate.HumidityMap, climate.WindMap };
+
+  ClimateRecord r;
+  r.day = day;
+  for(int m = 0; m<3; m++){
+    const float* map = maps[m];
+    double sum = 0;
+    float lo = map[0], hi = map[0];
+    for(size_t cell = 0; cell<gridSizeSq; cell++){
+      sum += map[cell];
+      lo = std::min(lo, map[cell]);
+      hi = std::max(hi, map[cell]);
+    }
+    r.mean[m] = sum/gridSizeSq;
+    r.min[m] = lo;
+    r.max[m] = hi;
+  }
+  size_t rain = 0, cloud = 0;
+  for(size_t cell = 0; cell<gridSizeSq; cell++){
+    rain += climate.RainMap[cell];
+    cloud += climate.CloudMap[cell];
+  }
+  r.rainFraction = (float)rain/gridSizeSq;
+  r.cloudFraction = (float)cloud/gridSizeSq;
+  r.windDirection[0] = climate.WindDirection[0];
+  r.windDirection[1] = climate.WindDirection[1];
+  if(!records.push(r)) droppedRecords++;
+
+  //Full Fields into a free Slot, if the Writer has returned one
+  if(frameInterval > 0 && day%frameInterval == 0){
+    int slot;
+    if(!freeFrames.pop(slot)){
+      droppedFrames++;
+      return;
+    }
+    Frame& f = frames[slot];
+    f.day = day;
+    std::copy(climate.TempMap, climate.TempMap+gridSizeSq, f.temp.begin());
+    std::copy(climate.HumidityMap, climate.HumidityMap+gridSizeSq, f.humidity.begin());
+    std::copy(climate.WindMap, climate.WindMap+gridSizeSq, f.wind.begin());
+    std::copy(climate.CloudMap, climate.CloudMap+gridSizeSq, f.cloud.begin());
+    std::copy(climate.RainMap, climate.RainMap+gridSizeSq, f.rain.begin());
+    filledFrames.push(slot);
+  }
+}
+
+void ClimateExporter::write(){
+  std::ofstream csv(prefix+".csv");
+  csv << "day,tempMean,tempMin,tempMax,humidityMean,humidityMin,humidityMax,windMean,windMin,windMax,rainFraction,cloudFraction,windDirectionX,windDirectionY\n";
+  std::ofstream bin;
+  if(frameInterval > 0) bin.open(prefix+".frames", std::ios::binary);
+
+  /*
+  Frame Layout, little endian:
+  char[4] "CLIM", int32 day, int32 gridSize,
+  float Temp[n], float Humidity[n], float Wind[n], uint8 Cloud[n], uint8 Rain[n]
+  */
+  const int32_t size = (int32_t)gridSize;
+  const size_t gridSizeSq = gridSize*gridSize;
+  char line[512];
+  while(true){
+    //Read the Flag first, so everything pushed before Shutdown is still drained
+    const bool last = !running.load();
+    bool idle = true;
+
+    ClimateRecord r;
+    while(records.pop(r)){
+      idle = false;
+      snprintf(line, sizeof(line), "%d,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g\n", r.day,
+        r.mean[0], r.min[0], r.max[0], r.mean[1], r.min[1], r.max[1], r.mean[2], r.min[2], r.max[2],
+        r.rainFraction, r.cloudFraction, r.windDirection[0], r.windDirection[1]);
+      csv << line;
+    }
+
+    int slot;
+    while(filledFrames.pop(slot)){
+      idle = false;
+      const Frame& f = frames[slot];
+      const int32_t day = f.day;
+      bin.write("CLIM", 4);
+      bin.write((const char*)&day, sizeof(day));
+      bin.write((const char*)&size, sizeof(size));
+      bin.write((const char*)f.temp.data(), gridSizeSq*sizeof(float));
+      bin.write((const char*)f.humidity.data(), gridSizeSq*sizeof(float));
+      bin.write((const char*)f.wind.data(), gridSizeSq*sizeof(float));
+      bin.write((const char*)f.cloud.data(), gridSizeSq);
+      bin.write((const char*)f.rain.data(), gridSizeSq);
+      freeFrames.push(slot);
+    }
+
+    if(last) break;
+    if(idle){
+      csv.flush();
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+  }
+}
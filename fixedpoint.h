@@ -0,0 +1,278 @@
+//Reduced Precision Climate
+//Temperature and Humidity in 16 Bit Fixed Point (65535 = 1), Wind in signed 8.8.
+//Half the Bytes per Cell of the Float Maps, for Previews and Ensembles that can spare a little Accuracy.
+#include <stdint.h>
+
+enum ClimatePrecision {
+  PRECISION_FLOAT,
+  PRECISION_FIXED16
+};
+
+//Precision calcAverage simulates the Year in, TERRITORY_PRECISION=16 for Fixed Point
+ClimatePrecision& climatePrecision(){
+  static ClimatePrecision precision =
+    getenv("TERRITORY_PRECISION") != NULL && atoi(getenv("TERRITORY_PRECISION")) == 16 ? PRECISION_FIXED16 : PRECISION_FLOAT;
+  return precision;
+}
+
+const int32_t fixedOne = 65535;
+const int32_t fixedWindOne = 256;
+
+inline uint16_t toFixed(float v){
+  return (uint16_t)lrintf(std::min(std::max(v, 0.0f), 1.0f)*fixedOne);
+}
+
+inline float fromFixed(uint16_t v){
+  return v*(1.0f/fixedOne);
+}
+
+inline int16_t toFixedWind(float v){
+  return (int16_t)std::min(std::max(lrintf(v*fixedWindOne), -32768l), 32767l);
+}
+
+inline float fromFixedWind(int16_t v){
+  return v*(1.0f/fixedWindOne);
+}
+
+//Fixed Point Counterpart of KernelArgs, Products are taken with Factors scaled to 1<<16
+struct FixedArgs {
+  size_t gridSize = 0;
+  uint16_t* temp = nullptr;
+  uint16_t* humidity = nullptr;
+  int16_t* wind = nullptr;
+  bool* cloud = nullptr;
+  bool* rain = nullptr;
+  const uint16_t* oldMap = nullptr;
+  const bool* oldCloud = nullptr;
+  const bool* oldRain = nullptr;
+  const float* depth = nullptr;
+  const unsigned char* sea = nullptr;
+  const uint16_t* sun = nullptr;
+  //Upwind Distance per Unit of fixed Wind, 2*WindDirection/fixedWindOne
+  double advect[2] = {0,0};
+  int windOffset[2] = {0,0};
+};
+
+template<size_t N>
+struct FixedWindKernel {
+  static void row(const FixedArgs& a, size_t i, size_t j0, size_t j1){
+    const size_t gridSize = N ? N : a.gridSize;
+    for(size_t j=j0; j<j1; j++){
+      long k = (long)i+a.windOffset[0];
+      if(k == -1){k = 0;};
+      if(k < 0 || k > (long)gridSize-1){k = i;};
+      long l = (long)j+a.windOffset[1];
+      if(l == -1){l = 0;};
+      if(l < 0 || l > (long)gridSize-1){l = j;};
+
+      const size_t cell = i*gridSize+j;
+      a.wind[cell] = toFixedWind(5*(1-(a.depth[cell]-a.depth[k*gridSize+l])/1000));
+    }
+  }
+  static void run(const FixedArgs& a){
+    const size_t gridSize = N ? N : a.gridSize;
+    parallelRanges(gridSize, parallelMinRows, [&](size_t i0, size_t i1){
+      for(size_t i=i0; i<i1; i++) row(a, i, 0, gridSize);
+    });
+  }
+};
+
+template<size_t N>
+struct FixedTempKernel {
+  //Branch free in 32 Bit so the Row vectorizes, the Products are split where they would overflow.
+  //Bit identical to the Formulas in 64 Bit noted beside them.
+  static void row(const FixedArgs& a, size_t i, size_t j0, size_t j1){
+    const size_t gridSize = N ? N : a.gridSize;
+    const uint16_t* cur = a.temp;
+    const uint16_t* old = a.oldMap;
+    uint16_t* out = a.temp+i*gridSize;
+    const uint16_t* up = cur+(i-1)*gridSize;
+    const uint16_t* down = old+(i+1)*gridSize;
+    const int16_t* wind = a.wind+i*gridSize;
+    //Flags read as Bytes, the Vectorizer doesn't widen bool
+    const uint8_t* cloud = (const uint8_t*)(a.cloud+i*gridSize);
+    const uint8_t* rain = (const uint8_t*)(a.rain+i*gridSize);
+    const uint16_t* sun = a.sun+i*gridSize;
+    for(size_t j=j0; j<j1; j++){
+      const int32_t temp = ((int32_t)up[j-1]+down[j-1]+down[j+1]+up[j+1])>>2;
+
+      //0.5*(wind-5): (w*65535)>>9 == w*128+((-w)>>9)
+      const int32_t w = wind[j]-5*fixedWindOne;
+      const int32_t addCool = w*128+((-w)>>9);
+      const uint32_t addSun = sun[j] & ((uint32_t)cloud[j]-1u);
+      const int32_t addRain = -655 & (0-((int32_t)rain[j] & (int32_t)(temp>0)));
+
+      //0.8 and 0.6: (x*y)>>16 with y split into its high and low 16 Bits
+      const uint32_t heat = ((((52429u*(uint32_t)(fixedOne-temp))>>16)*addSun)>>16);
+      const int32_t factor = (int32_t)((39322u*(uint32_t)temp)>>16);
+      const int32_t change = addRain+addCool;
+      const int32_t cool = factor*(change>>16)+(int32_t)(((uint32_t)factor*(uint32_t)(change&0xffff))>>16);
+      int32_t next = temp+(int32_t)heat+cool;
+      next = std::min(std::max(next, (int32_t)0), fixedOne);
+      out[j] = (uint16_t)next;
+    }
+  }
+  static void run(const FixedArgs& a){
+    wavefront<FixedTempKernel>(a, N ? N : a.gridSize);
+  }
+};
+
+template<size_t N>
+struct FixedHumidityKernel {
+  static void row(const FixedArgs& a, size_t i, size_t j0, size_t j1){
+    const size_t gridSize = N ? N : a.gridSize;
+    const uint16_t* cur = a.humidity;
+    const uint16_t* old = a.oldMap;
+    const size_t prevRow = (i-1)*gridSize;
+    const size_t nextRow = (i+1)*gridSize;
+    for(size_t j=j0; j<j1; j++){
+      const size_t cell = i*gridSize+j;
+
+      size_t k = i+a.wind[cell]*a.advect[0];
+      if(k > gridSize-1){k = i;};
+      size_t l = j+a.wind[cell]*a.advect[1];
+      if(l > gridSize-1){l = j;};
+
+      int64_t humidity =
+        ((int32_t)cur[prevRow+j-1]+cur[prevRow+j]+cur[prevRow+j+1]+
+         cur[cell-1]+old[k*gridSize+l]+old[cell+1]+
+         old[nextRow+j-1]+old[nextRow+j]+old[nextRow+j+1]
+        )/9;
+
+      //0.05*temp over Water, 0.01 over Land
+      int64_t addHumidity = 0;
+      if(a.cloud[cell]==0){
+        addHumidity = a.sea[cell] ? (3277*(int64_t)a.temp[cell])>>16 : 655;
+      }
+      //-0.8*humidity
+      const int64_t addRain = a.rain[cell] ? -((52429*humidity)>>16) : 0;
+
+      humidity += ((humidity*addRain)>>16)+(((fixedOne-humidity)*addHumidity)>>16);
+      humidity = std::min(std::max(humidity, (int64_t)0), (int64_t)fixedOne);
+      a.humidity[cell] = (uint16_t)humidity;
+    }
+  }
+  static void run(const FixedArgs& a){
+    wavefront<FixedHumidityKernel>(a, N ? N : a.gridSize);
+  }
+};
+
+template<size_t N>
+struct FixedDownfallKernel {
+  static void row(const FixedArgs& a, size_t i, size_t j0, size_t j1){
+    const size_t gridSize = N ? N : a.gridSize;
+    for(size_t j=j0; j<j1; j++){
+      const size_t cell = i*gridSize+j;
+
+      size_t k = i+a.wind[cell]*a.advect[0];
+      if(k > gridSize-1){k = i;};
+      size_t l = j+a.wind[cell]*a.advect[1];
+      if(l > gridSize-1){l = j;};
+
+      const size_t fromCell = k*gridSize+l;
+
+      //0.35+0.5*temp and 0.3+0.3*temp, as Masks instead of Branches
+      const int32_t humidity = a.humidity[cell];
+      const int32_t temp = a.temp[cell];
+      const bool rainNow = humidity >= 22938+(temp>>1);
+      const bool cloudNow = !rainNow & (humidity >= 19661+((19661*temp)>>16));
+      //Rain keeps the upwind Cloud, Cloud keeps the upwind Rain, dry Air clears both
+      a.cloud[cell] = cloudNow | (rainNow & a.oldCloud[fromCell]);
+      a.rain[cell] = rainNow | (cloudNow & a.oldRain[fromCell]);
+    }
+  }
+  static void run(const FixedArgs& a){
+    const size_t gridSize = N ? N : a.gridSize;
+    memset(a.cloud, 0, gridSize*sizeof(bool));
+    memset(a.rain, 0, gridSize*sizeof(bool));
+    parallelRanges(gridSize-2, parallelMinRows, [&](size_t i0, size_t i1){
+      for(size_t i=i0+1; i<i1+1; i++){
+        a.cloud[i*gridSize] = a.rain[i*gridSize] = 0;
+        a.cloud[i*gridSize+gridSize-1] = a.rain[i*gridSize+gridSize-1] = 0;
+        row(a, i, 1, gridSize-1);
+      }
+    });
+    memset(a.cloud+(gridSize-1)*gridSize, 0, gridSize*sizeof(bool));
+    memset(a.rain+(gridSize-1)*gridSize, 0, gridSize*sizeof(bool));
+  }
+};
+
+//Simulation State in Fixed Point, steps like Climate::step
+class FixedClimate {
+  public:
+  FixedClimate(size_t gridSize);
+
+  size_t gridSize;
+  uint16_t* temp;
+  uint16_t* humidity;
+  int16_t* wind;
+  bool* cloud;
+  bool* rain;
+
+  //Starts from the Float Maps of an initialised Climate
+  void load(const float* temp, const float* humidity, const float* wind, const bool* cloud, const bool* rain, const float* sun);
+  void step(const WindDay& day, const float* depth, const unsigned char* sea);
+
+  private:
+  GridArena storage;
+  uint16_t* oldMap;
+  bool* oldCloud;
+  bool* oldRain;
+  uint16_t* sun;
+};
+
+FixedClimate::FixedClimate(size_t gridSizeIn) : gridSize(gridSizeIn) {
+  const size_t gridSizeSq = gridSize*gridSize;
+  storage.reserve(5*GridArena::bytes<uint16_t>(gridSizeSq)+4*GridArena::bytes<bool>(gridSizeSq));
+  temp = storage.layer<uint16_t>(gridSizeSq, "fixed climate");
+  humidity = storage.layer<uint16_t>(gridSizeSq, "fixed climate");
+  wind = storage.layer<int16_t>(gridSizeSq, "fixed climate");
+  cloud = storage.layer<bool>(gridSizeSq, "fixed climate");
+  rain = storage.layer<bool>(gridSizeSq, "fixed climate");
+  oldMap = storage.layer<uint16_t>(gridSizeSq, "fixed climate");
+  oldCloud = storage.layer<bool>(gridSizeSq, "fixed climate");
+  oldRain = storage.layer<bool>(gridSizeSq, "fixed climate");
+  sun = storage.layer<uint16_t>(gridSizeSq, "fixed climate");
+}
+
+void FixedClimate::load(const float* tempIn, const float* humidityIn, const float* windIn, const bool* cloudIn, const bool* rainIn, const float* sunIn){
+  const size_t gridSizeSq = gridSize*gridSize;
+  for(size_t cell = 0; cell<gridSizeSq; cell++){
+    temp[cell] = toFixed(tempIn[cell]);
+    humidity[cell] = toFixed(humidityIn[cell]);
+    wind[cell] = toFixedWind(windIn[cell]);
+    sun[cell] = toFixed(sunIn[cell]);
+  }
+  memcpy(cloud, cloudIn, gridSizeSq*sizeof(bool));
+  memcpy(rain, rainIn, gridSizeSq*sizeof(bool));
+}
+
+void FixedClimate::step(const WindDay& day, const float* depth, const unsigned char* sea){
+  const size_t gridSizeSq = gridSize*gridSize;
+  FixedArgs a;
+  a.gridSize = gridSize;
+  a.temp = temp;
+  a.humidity = humidity;
+  a.wind = wind;
+  a.cloud = cloud;
+  a.rain = rain;
+  a.oldMap = oldMap;
+  a.oldCloud = oldCloud;
+  a.oldRain = oldRain;
+  a.depth = depth;
+  a.sea = sea;
+  a.sun = sun;
+  a.advect[0] = 2*day.direction[0]/fixedWindOne;
+  a.advect[1] = 2*day.direction[1]/fixedWindOne;
+  a.windOffset[0] = day.offset[0];
+  a.windOffset[1] = day.offset[1];
+
+  dispatchGrid<FixedWindKernel>(a);
+  memcpy(oldMap, temp, gridSizeSq*sizeof(uint16_t));
+  dispatchGrid<FixedTempKernel>(a);
+  memcpy(oldMap, humidity, gridSizeSq*sizeof(uint16_t));
+  dispatchGrid<FixedHumidityKernel>(a);
+  memcpy(oldCloud, cloud, gridSizeSq*sizeof(bool));
+  memcpy(oldRain, rain, gridSizeSq*sizeof(bool));
+  dispatchGrid<FixedDownfallKernel>(a);
+}
@@ -0,0 +1,64 @@
+//Hydrology: Depression Filling, D8 Flow Directions and Flow Accumulation
+#include <queue>
+#include <vector>
+#include <stdint.h>
+
+//D8 Neighbour Offsets, Direction d points from a Cell to its Neighbour d
+const int flowDi[8] = {-1,-1,-1, 0, 0, 1, 1, 1};
+const int flowDj[8] = {-1, 0, 1,-1, 1,-1, 0, 1};
+const unsigned char flowNone = 0xff;
+
+/*
+Priority-Flood (Barnes et al. 2014) with a Pit Queue:
+Starting from the Outlets (Grid Edge and Sea), the lowest Cell on the Flooded Border is taken next,
+its unvisited Neighbours drain into it and are raised to at least its Level.
+Cells inside a Depression are no higher than the Border and go through a plain FIFO instead of the Heap.
+Every Cell gets a Direction towards the Cell that flooded it, and order lists Cells so that
+every Receiver comes before the Cells that drain into it.
+*/
+void priorityFlood(size_t gridSize, const float* depth, const unsigned char* outlet,
+                   unsigned char* direction, std::vector<uint32_t>& order){
+  const size_t gridSizeSq = gridSize*gridSize;
+  typedef std::pair<float, uint32_t> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+  std::queue<Entry> pit;
+  std::vector<unsigned char> closed(gridSizeSq, 0);
+  order.clear();
+  order.reserve(gridSizeSq);
+
+  for(size_t cell = 0; cell<gridSizeSq; cell++){
+    const size_t i = cell/gridSize, j = cell%gridSize;
+    const bool edge = i == 0 || j == 0 || i == gridSize-1 || j == gridSize-1;
+    direction[cell] = flowNone;
+    if(edge || outlet[cell]){
+      closed[cell] = 1;
+      open.push(Entry(depth[cell], (uint32_t)cell));
+    }
+  }
+
+  while(!open.empty() || !pit.empty()){
+    Entry top;
+    if(!pit.empty()){
+      top = pit.front();
+      pit.pop();
+    }
+    else{
+      top = open.top();
+      open.pop();
+    }
+    const uint32_t cell = top.second;
+    order.push_back(cell);
+    const int i = (int)(cell/gridSize), j = (int)(cell%gridSize);
+    for(int d = 0; d<8; d++){
+      const int ni = i+flowDi[d], nj = j+flowDj[d];
+      if(ni < 0 || nj < 0 || ni >= (int)gridSize || nj >= (int)gridSize) continue;
+      const uint32_t next = (uint32_t)(ni*gridSize+nj);
+      if(closed[next]) continue;
+      closed[next] = 1;
+      //Drains into the Cell that reached it, the opposite Direction
+      direction[next] = 7-d;
+      if(depth[next] <= top.first) pit.push(Entry(top.first, next));
+      else open.push(Entry(depth[next], next));
+    }
+  }
+}
@@ -0,0 +1,305 @@
+//Climate Kernels
+//Specialized for the standard Grid Sizes so Index Math and Bounds are Compile Time Constants.
+//Kernel<0> is the generic Fallback that reads the Size at Runtime.
+#include <atomic>
+#include <memory>
+
+//Arguments shared by all Kernels of one Step, the Kernels only use what they need
+struct KernelArgs {
+  size_t gridSize = 0;
+  //Current Maps, written in Row Order: Rows above the Current Row hold the new Day
+  float* temp = nullptr;
+  float* humidity = nullptr;
+  float* wind = nullptr;
+  bool* cloud = nullptr;
+  bool* rain = nullptr;
+  //Previous Day of the Map being updated
+  const float* oldMap = nullptr;
+  const bool* oldCloud = nullptr;
+  const bool* oldRain = nullptr;
+  const float* depth = nullptr;
+  //Static Terrain Fields, see Terrain::calcFields
+  const unsigned char* sea = nullptr;
+  const float* sun = nullptr;
+  double windDirection[2] = {1,1};
+  int windOffset[2] = {0,0};
+};
+
+//Grids below this many Rows are cheaper to run on one Thread
+const size_t parallelMinRows = 200;
+
+//Row Order Wavefront: Row i may compute Column j once Row i-1 has finished Column j+1.
+//Every Cell sees exactly the Neighbours the serial Loop would, for any Worker Count.
+template<class Kernel, class Args>
+void wavefront(const Args& a, size_t gridSize){
+  WorkerPool& pool = workers();
+  const size_t n = pool.size();
+  if(n == 1 || gridSize < parallelMinRows){
+    for(size_t i=1; i<gridSize-1; i++) Kernel::row(a, i, 1, gridSize-1);
+    return;
+  }
+  //Columns finished per Row
+  std::unique_ptr<std::atomic<size_t>[]> progress(new std::atomic<size_t>[gridSize]);
+  for(size_t i=0; i<gridSize; i++) progress[i].store(1, std::memory_order_relaxed);
+  const size_t block = 32;
+  pool.run([&](int w){
+    for(size_t i=1+w; i<gridSize-1; i+=n){
+      for(size_t j0=1; j0<gridSize-1; j0+=block){
+        const size_t j1 = std::min(j0+block, gridSize-1);
+        if(i > 1){
+          const size_t need = std::min(j1+1, gridSize-1);
+          while(progress[i-1].load(std::memory_order_acquire) < need) std::this_thread::yield();
+        }
+        Kernel::row(a, i, j0, j1);
+        progress[i].store(j1, std::memory_order_release);
+      }
+    }
+  });
+}
+
+//Runs Kernel<N>::run with N fixed for the standard Sizes
+template<template<size_t> class Kernel, class Args>
+void dispatchGrid(const Args& a){
+  switch(a.gridSize){
+    case 100: Kernel<100>::run(a); break;
+    case 250: Kernel<250>::run(a); break;
+    case 500: Kernel<500>::run(a); break;
+    case 1000: Kernel<1000>::run(a); break;
+    default: Kernel<0>::run(a);
+  }
+}
+
+//Wind Strength from the Height Difference to the Upwind Tile
+template<size_t N>
+struct WindKernel {
+  static void row(const KernelArgs& a, size_t i, size_t j0, size_t j1){
+    const size_t gridSize = N ? N : a.gridSize;
+    for(size_t j=j0; j<j1; j++){
+      //Previous Tiles, less than one Cell past the low Edge still lands on it
+      long k = (long)i+a.windOffset[0];
+      if(k == -1){k = 0;};
+      if(k < 0 || k > (long)gridSize-1){k = i;};
+      long l = (long)j+a.windOffset[1];
+      if(l == -1){l = 0;};
+      if(l < 0 || l > (long)gridSize-1){l = j;};
+
+      const size_t cell = i*gridSize+j;
+      const size_t fromCell = k*gridSize+l;
+      a.wind[cell]=5*(1-(a.depth[cell]-a.depth[fromCell])/1000);
+    }
+  }
+  static void run(const KernelArgs& a){
+    const size_t gridSize = N ? N : a.gridSize;
+    parallelRanges(gridSize, parallelMinRows, [&](size_t i0, size_t i1){
+      for(size_t i=i0; i<i1; i++) row(a, i, 0, gridSize);
+    });
+  }
+};
+
+//Temperature: oldMap holds yesterday's TempMap, cloud and rain are still yesterday's
+template<size_t N>
+struct TempKernel {
+  static void row(const KernelArgs& a, size_t i, size_t j0, size_t j1){
+    const size_t gridSize = N ? N : a.gridSize;
+    const float* cur = a.temp;
+    const float* old = a.oldMap;
+    for(size_t j=j0; j<j1; j++){
+      const size_t cell = i*gridSize+j;
+
+      //Average (from corners to this cell), the Row below has not been updated yet
+      float temp = (cur[(i-1)*gridSize+j-1]+old[(i+1)*gridSize+j-1]+old[(i+1)*gridSize+j+1]+cur[(i-1)*gridSize+j+1])/4;
+
+      //Various Contributions to the TempMap
+      //Rising Air Cools
+      float addCool = 0.5*(a.wind[cell]-5);
+
+      //Sunlight on Surface
+      const float addSun = a.cloud[cell] ? 0 : a.sun[cell];
+
+      float addRain = 0;
+      if(a.rain[cell]==1 && temp>0){
+        //Rain Reduces Temperature
+        addRain = -0.01;
+      }
+
+      //Add Contributions
+      temp+=0.8*(1-temp)*(addSun)+0.6*(temp)*(addRain+addCool);
+      if(temp>1){temp=1;}
+      if(temp<0){temp=0;}
+      a.temp[cell] = temp;
+    }
+  }
+  static void run(const KernelArgs& a){
+    wavefront<TempKernel>(a, N ? N : a.gridSize);
+  }
+};
+
+//Humidity: oldMap holds yesterday's HumidityMap, temp is today's, cloud and rain yesterday's
+template<size_t N>
+struct HumidityKernel {
+  static void row(const KernelArgs& a, size_t i, size_t j0, size_t j1){
+    const size_t gridSize = N ? N : a.gridSize;
+    const float* cur = a.humidity;
+    const float* old = a.oldMap;
+    const size_t prevRow  = (i-1)*gridSize;
+    const size_t nextRow  = (i+1)*gridSize;
+    for(size_t j=j0; j<j1; j++){
+      const size_t cell = i*gridSize+j;
+
+      //Get New Map from Wind Direction
+      //Indices of Previous Tile
+      //Assumption: Wind Blows Despite Obstacles
+      size_t k = i+2*a.wind[cell]*(a.windDirection[0]);
+      if(k > gridSize-1){k = i;};
+      size_t l = j+2*a.wind[cell]*(a.windDirection[1]);
+      if(l > gridSize-1){l = j;};
+
+      const size_t fromCell = k*gridSize+l;
+
+      //Transfer to New Tile, then Average (with all surrounding cells)
+      float humidity = old[fromCell];
+      humidity =
+        (cur[prevRow+j-1]+cur[prevRow+j]+cur[prevRow+j+1]+
+         cur[cell -1]+humidity +old[cell+1] +
+         old[nextRow+j-1]+old[nextRow+j]+old[nextRow+j+1]
+        )/9;
+
+      //We are over a body of water, temperature accelerates
+      float addHumidity=0;
+      if(a.cloud[cell]==0){
+        addHumidity = a.sea[cell] ? 0.05*a.temp[cell] : 0.01;
+      }
+
+      //Raining
+      float addRain=0;
+      if(a.rain[cell]==1){
+        addRain = -(humidity)*0.8;
+      }
+
+      humidity+=(humidity)*addRain+(1-humidity)*(addHumidity);
+      if(humidity>1){humidity=1;}
+      if(humidity<0){humidity=0;}
+      a.humidity[cell] = humidity;
+    }
+  }
+  static void run(const KernelArgs& a){
+    wavefront<HumidityKernel>(a, N ? N : a.gridSize);
+  }
+};
+
+//Clouds and Rain: oldCloud and oldRain hold yesterday's Maps, the Edge stays clear
+template<size_t N>
+struct DownfallKernel {
+  static void row(const KernelArgs& a, size_t i, size_t j0, size_t j1){
+    const size_t gridSize = N ? N : a.gridSize;
+    for(size_t j=j0; j<j1; j++){
+      const size_t cell = i*gridSize+j;
+
+      //Old Coordinates
+      size_t k = i+2*a.wind[cell]*(a.windDirection[0]);
+      if(k > gridSize-1){k = i;};
+      size_t l = j+2*a.wind[cell]*(a.windDirection[1]);
+      if(l > gridSize-1){l = j;};
+
+      const size_t fromCell = k*gridSize+l;
+
+      //Transfer to New Tile
+      bool cloud = a.oldCloud[fromCell];
+      bool rain = a.oldRain[fromCell];
+
+      //Rain Condition
+      if(a.humidity[cell]>=0.35+0.5*a.temp[cell]){
+        rain=1;
+      }
+      else if(a.humidity[cell]>=0.3+0.3*a.temp[cell]){
+        cloud=1;
+      }
+      else{
+        cloud=0;
+        rain=0;
+      }
+      a.cloud[cell] = cloud;
+      a.rain[cell] = rain;
+    }
+  }
+  static void edge(const KernelArgs& a, size_t i){
+    const size_t gridSize = N ? N : a.gridSize;
+    a.cloud[i*gridSize] = a.rain[i*gridSize] = 0;
+    a.cloud[i*gridSize+gridSize-1] = a.rain[i*gridSize+gridSize-1] = 0;
+  }
+  static void run(const KernelArgs& a){
+    const size_t gridSize = N ? N : a.gridSize;
+    memset(a.cloud, 0, gridSize*sizeof(bool));
+    memset(a.rain, 0, gridSize*sizeof(bool));
+    //Rows only read Yesterday's Clouds and Rain
+    parallelRanges(gridSize-2, parallelMinRows, [&](size_t i0, size_t i1){
+      for(size_t i=i0+1; i<i1+1; i++){
+        edge(a, i);
+        row(a, i, 1, gridSize-1);
+      }
+    });
+    memset(a.cloud+(gridSize-1)*gridSize, 0, gridSize*sizeof(bool));
+    memset(a.rain+(gridSize-1)*gridSize, 0, gridSize*sizeof(bool));
+  }
+};
+
+//Seasonal Means, see climatology.h
+class Climatology;
+void accumulateSeason(Climatology* season, int day, size_t first, size_t last,
+                      const float* wind, const bool* rain, const bool* cloud, const float* temp, const float* humidity);
+
+//One whole Day over a Band of Rows, for temporally blocked Stepping.
+//Every Day has its own Maps, so Yesterday stays readable while Today is written.
+struct DayArgs {
+  size_t gridSize = 0;
+  size_t i0 = 0;
+  size_t i1 = 0;
+  //Arguments of the single Kernels, Wind uses the Temperature Arguments
+  KernelArgs temp;
+  KernelArgs humidity;
+  KernelArgs downfall;
+  //Running Mean of Wind, Rain, Cloud, Temp and Humidity over the Days before avgDay, null to skip
+  float* avg[5] = {nullptr, nullptr, nullptr, nullptr, nullptr};
+  int avgDay = 0;
+  //Periods of the Year the Day is added to as well, null to skip
+  Climatology* season = nullptr;
+};
+
+template<size_t N>
+struct DayKernel {
+  static void run(const DayArgs& d){
+    const size_t gridSize = N ? N : d.gridSize;
+    for(size_t i=d.i0; i<d.i1; i++){
+      const size_t first = i*gridSize, last = first+gridSize-1;
+      WindKernel<N>::row(d.temp, i, 0, gridSize);
+      if(i == 0 || i == gridSize-1){
+        //Temperature and Humidity keep their Edge, Downfall clears it
+        memcpy(d.temp.temp+first, d.temp.oldMap+first, gridSize*sizeof(float));
+        memcpy(d.humidity.humidity+first, d.humidity.oldMap+first, gridSize*sizeof(float));
+        memset(d.downfall.cloud+first, 0, gridSize*sizeof(bool));
+        memset(d.downfall.rain+first, 0, gridSize*sizeof(bool));
+      }
+      else{
+        d.temp.temp[first] = d.temp.oldMap[first];
+        d.temp.temp[last] = d.temp.oldMap[last];
+        d.humidity.humidity[first] = d.humidity.oldMap[first];
+        d.humidity.humidity[last] = d.humidity.oldMap[last];
+        TempKernel<N>::row(d.temp, i, 1, gridSize-1);
+        HumidityKernel<N>::row(d.humidity, i, 1, gridSize-1);
+        DownfallKernel<N>::edge(d.downfall, i);
+        DownfallKernel<N>::row(d.downfall, i, 1, gridSize-1);
+      }
+      if(d.avg[0] == nullptr) continue;
+      if(d.season != nullptr)
+        accumulateSeason(d.season, d.avgDay, first, last, d.downfall.wind, d.downfall.rain, d.downfall.cloud, d.downfall.temp, d.downfall.humidity);
+      const int n = d.avgDay;
+      for(size_t cell=first; cell<=last; cell++){
+        d.avg[0][cell] = (d.avg[0][cell]*n+d.downfall.wind[cell])/(n+1);
+        d.avg[1][cell] = (d.avg[1][cell]*n+d.downfall.rain[cell])/(n+1);
+        d.avg[2][cell] = (d.avg[2][cell]*n+d.downfall.cloud[cell])/(n+1);
+        d.avg[3][cell] = (d.avg[3][cell]*n+d.downfall.temp[cell])/(n+1);
+        d.avg[4][cell] = (d.avg[4][cell]*n+d.downfall.humidity[cell])/(n+1);
+      }
+    }
+  }
+};
@@ -0,0 +1,77 @@
+//Frame Pacing for the Game Loop
+//Simulation Days run on a fixed Timestep out of the real Time that passed, Frames are drawn at a steady Rate.
+//Between Frames the Loop sleeps until the next Deadline instead of for a fixed Delay, whatever the Frame cost.
+#include <chrono>
+#include <thread>
+
+class FramePacer {
+  public:
+  typedef std::chrono::steady_clock Clock;
+
+  FramePacer(double frameMS, double stepMS);
+
+  //Milliseconds between Frames, 0 if Presenting waits for the Display already
+  double frameMS;
+  //Milliseconds of real Time per Simulation Step
+  double stepMS;
+  //Steps one Frame may run to catch up, Time beyond that is dropped.
+  //Steps that take longer than a Frame are cut short by late() as well.
+  int maxSteps = 4;
+
+  //Steps due since the last Call
+  int steps();
+  //True once the Frame has used up its Time, Steps left then are dropped
+  bool late() const;
+  //Forgets the Time that passed, for Views that don't simulate
+  void hold();
+  //Sleeps until the next Frame is due
+  void wait();
+
+  private:
+  Clock::time_point last;
+  Clock::time_point deadline;
+  double accumulated = 0;
+};
+
+FramePacer::FramePacer(double frameMSIn, double stepMSIn) : frameMS(frameMSIn), stepMS(stepMSIn) {
+  last = deadline = Clock::now();
+}
+
+int FramePacer::steps(){
+  const Clock::time_point now = Clock::now();
+  accumulated += std::chrono::duration<double, std::milli>(now-last).count();
+  last = now;
+  int n = (int)(accumulated/stepMS);
+  accumulated -= n*stepMS;
+  //A slow Step must not make the next Frame slower still
+  if(n > maxSteps){
+    n = maxSteps;
+    accumulated = 0;
+  }
+  return n;
+}
+
+bool FramePacer::late() const {
+  const double budget = frameMS > 0 ? frameMS : 1000.0/60;
+  return std::chrono::duration<double, std::milli>(Clock::now()-last).count() > budget;
+}
+
+void FramePacer::hold(){
+  last = Clock::now();
+  accumulated = 0;
+}
+
+void FramePacer::wait(){
+  if(frameMS <= 0) return;
+  const Clock::duration frame = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(frameMS));
+  const Clock::time_point now = Clock::now();
+  deadline += frame;
+  //More than a Frame late: start the Schedule over rather than rush the Frames missed
+  if(deadline+frame < now) deadline = now;
+  if(deadline <= now) return;
+
+  //The Scheduler may wake a little late, the last Stretch is yielded through
+  const Clock::duration slack = std::chrono::microseconds(200);
+  if(deadline-now > slack) std::this_thread::sleep_until(deadline-slack);
+  while(Clock::now() < deadline) std::this_thread::yield();
+}
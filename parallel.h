@@ -0,0 +1,114 @@
+//Worker Pool for Data-Parallel Loops
+//Every Loop splits its Range the same Way and writes disjoint Cells, so Results don't depend on the Worker Count
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <stdlib.h>
+
+class WorkerPool {
+  public:
+  WorkerPool(int count);
+  ~WorkerPool();
+
+  int size() const { return (int)threads.size()+1; }
+  //Runs task(worker) once on every Worker, the calling Thread is Worker 0
+  void run(const std::function<void(int)>& task);
+
+  private:
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  const std::function<void(int)>* current = nullptr;
+  unsigned int generation = 0;
+  int pending = 0;
+  bool stop = false;
+
+  void work(int worker);
+};
+
+WorkerPool::WorkerPool(int count){
+  for(int w = 1; w<count; w++)
+    threads.push_back(std::thread(&WorkerPool::work, this, w));
+}
+
+WorkerPool::~WorkerPool(){
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  wake.notify_all();
+  for(size_t t = 0; t<threads.size(); t++) threads[t].join();
+}
+
+void WorkerPool::run(const std::function<void(int)>& task){
+  if(threads.empty()){
+    task(0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    current = &task;
+    pending = (int)threads.size();
+    generation++;
+  }
+  wake.notify_all();
+  task(0);
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this]{ return pending == 0; });
+}
+
+void WorkerPool::work(int worker){
+  unsigned int seen = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+  while(true){
+    wake.wait(lock, [this, seen]{ return stop || generation != seen; });
+    if(stop) return;
+    seen = generation;
+    const std::function<void(int)>* task = current;
+    lock.unlock();
+    (*task)(worker);
+    lock.lock();
+    if(--pending == 0) done.notify_one();
+  }
+}
+
+//Shared Pool, sized from TERRITORY_THREADS or the Hardware
+std::unique_ptr<WorkerPool>& workerPool(){
+  static std::unique_ptr<WorkerPool> pool;
+  return pool;
+}
+
+void setWorkerCount(int count){
+  workerPool().reset(new WorkerPool(std::max(1, count)));
+}
+
+WorkerPool& workers(){
+  std::unique_ptr<WorkerPool>& pool = workerPool();
+  if(!pool){
+    int count = (int)std::thread::hardware_concurrency();
+    if(getenv("TERRITORY_THREADS") != NULL) count = atoi(getenv("TERRITORY_THREADS"));
+    setWorkerCount(count);
+  }
+  return *pool;
+}
+
+//Calls f(begin, end) on one contiguous Range per Worker, serially below minCount
+template<class F>
+void parallelRanges(size_t count, size_t minCount, F f){
+  WorkerPool& pool = workers();
+  const size_t n = pool.size();
+  if(n == 1 || count < minCount){
+    f((size_t)0, count);
+    return;
+  }
+  pool.run([&](int w){
+    const size_t begin = count*w/n;
+    const size_t end = count*(w+1)/n;
+    if(begin < end) f(begin, end);
+  });
+}
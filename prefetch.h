@@ -0,0 +1,186 @@
+//Local Area Prefetching
+//A Worker Thread generates the Areas ahead of the Player, Slots are handed over through Rings without Locks.
+//The Worker sleeps on a Condition Variable while nothing is requested, so a Player standing still costs nothing.
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "ring.h"
+
+//Height and Vegetation of one Local Area
+struct LocalArea {
+  int xTotal = 0;
+  int yTotal = 0;
+  std::vector<float> depth;
+  std::vector<unsigned char> tree;
+};
+
+class LocalPrefetcher {
+  public:
+  LocalPrefetcher(const World* territory);
+  ~LocalPrefetcher();
+
+  //Area around the Player for this Frame, generated in Place only if no Prefetch covered it
+  const LocalArea& area(int xTotal, int yTotal);
+
+  private:
+  enum SlotState { SLOT_EMPTY, SLOT_PENDING, SLOT_READY };
+  static const int slotCount = 8;
+  //Areas requested ahead of the Player
+  static const int lookahead = 3;
+
+  const World* territory;
+  //The Render Thread owns every Slot that isn't Pending
+  LocalArea slots[slotCount];
+  SlotState state[slotCount];
+  unsigned int lastUse[slotCount];
+  unsigned int frame = 0;
+  //At most lookahead Slots are with the Worker, so a Miss always finds a Slot
+  int pending = 0;
+
+  //Motion Prediction from the last Position Change
+  int lastX = 0;
+  int lastY = 0;
+  int stepX = 0;
+  int stepY = 0;
+  bool tracking = false;
+
+  SpscRing<int> requests;
+  SpscRing<int> finished;
+  //Requests pushed but not yet taken, guarded by wake
+  int queued = 0;
+  bool running = true;
+  std::mutex wake;
+  std::condition_variable signal;
+  std::thread worker;
+
+  static void fill(const World* territory, LocalArea& area);
+  int find(int xTotal, int yTotal, bool pending) const;
+  int evict(int keep) const;
+  void request(int slot);
+  void work();
+};
+
+LocalPrefetcher::LocalPrefetcher(const World* territoryIn) :
+  territory(territoryIn), requests(slotCount), finished(slotCount) {
+  for(int s = 0; s<slotCount; s++){
+    slots[s].depth.resize(localGrid*localGrid);
+    slots[s].tree.resize(localGrid*localGrid);
+    state[s] = SLOT_EMPTY;
+    lastUse[s] = 0;
+  }
+  worker = std::thread(&LocalPrefetcher::work, this);
+}
+
+LocalPrefetcher::~LocalPrefetcher(){
+  {
+    std::lock_guard<std::mutex> lock(wake);
+    running = false;
+  }
+  signal.notify_one();
+  worker.join();
+}
+
+void LocalPrefetcher::fill(const World* territory, LocalArea& area){
+  territory->terrain.genLocal(territory->seed, area.xTotal, area.yTotal, area.depth.data());
+  for(int i = 0; i<localGrid; i++)
+    for(int j = 0; j<localGrid; j++)
+      area.tree[i*localGrid+j] = territory->vegetation.getTree(territory->seed, area.xTotal-localGrid/2+i, area.yTotal-localGrid/2+j);
+}
+
+void LocalPrefetcher::request(int slot){
+  requests.push(slot);
+  {
+    std::lock_guard<std::mutex> lock(wake);
+    queued++;
+  }
+  signal.notify_one();
+}
+
+void LocalPrefetcher::work(){
+  tracer.nameThread("prefetch");
+  while(true){
+    {
+      std::unique_lock<std::mutex> lock(wake);
+      signal.wait(lock, [this]{ return queued > 0 || !running; });
+      if(!running) return;
+      queued--;
+    }
+    int s;
+    if(!requests.pop(s)) continue;
+    TraceScope trace("prefetchLocal");
+    fill(territory, slots[s]);
+    finished.push(s);
+  }
+}
+
+int LocalPrefetcher::find(int xTotal, int yTotal, bool pending) const {
+  for(int s = 0; s<slotCount; s++){
+    if(state[s] == SLOT_EMPTY || (state[s] == SLOT_PENDING && !pending)) continue;
+    if(slots[s].xTotal == xTotal && slots[s].yTotal == yTotal) return s;
+  }
+  return -1;
+}
+
+int LocalPrefetcher::evict(int keep) const {
+  //Least recently used Slot the Worker doesn't hold
+  int victim = -1;
+  for(int s = 0; s<slotCount; s++){
+    if(s == keep || state[s] == SLOT_PENDING) continue;
+    if(state[s] == SLOT_EMPTY) return s;
+    if(victim < 0 || lastUse[s] < lastUse[victim]) victim = s;
+  }
+  return victim;
+}
+
+const LocalArea& LocalPrefetcher::area(int xTotal, int yTotal){
+  frame++;
+  int s;
+  while(finished.pop(s)){
+    state[s] = SLOT_READY;
+    lastUse[s] = frame;
+    pending--;
+  }
+
+  //Predict the next Steps from the last Move, Region and Global Borders are continuous in Total Coordinates
+  if(!tracking || xTotal != lastX || yTotal != lastY){
+    if(tracking){
+      stepX = (xTotal > lastX)-(xTotal < lastX);
+      stepY = (yTotal > lastY)-(yTotal < lastY);
+    }
+    lastX = xTotal;
+    lastY = yTotal;
+    tracking = true;
+  }
+
+  int current = find(xTotal, yTotal, false);
+  if(current < 0){
+    //Missed, generate on this Thread
+    current = evict(-1);
+    slots[current].xTotal = xTotal;
+    slots[current].yTotal = yTotal;
+    fill(territory, slots[current]);
+    state[current] = SLOT_READY;
+  }
+  lastUse[current] = frame;
+
+  for(int k = 1; k<=lookahead && (stepX != 0 || stepY != 0); k++){
+    const int x = xTotal+k*stepX;
+    const int y = yTotal+k*stepY;
+    const int hit = find(x, y, true);
+    if(hit >= 0){
+      lastUse[hit] = frame;
+      continue;
+    }
+    if(pending >= lookahead) break;
+    const int slot = evict(current);
+    slots[slot].xTotal = x;
+    slots[slot].yTotal = y;
+    state[slot] = SLOT_PENDING;
+    lastUse[slot] = frame;
+    request(slot);
+    pending++;
+  }
+  return slots[current];
+}
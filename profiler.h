@@ -0,0 +1,172 @@
+//Performance Instrumentation
+#include <chrono>
+#include <mutex>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <array>
+#include "trace.h"
+
+//Timed Stages
+enum ProfileStage {
+  PROFILE_FRAME,
+  PROFILE_GENDEPTH,
+  PROFILE_ERODE,
+  PROFILE_CALCFLOW,
+  PROFILE_CALCAVERAGE,
+  PROFILE_CLIMATEDAY,
+  PROFILE_CALCWIND,
+  PROFILE_CALCTEMP,
+  PROFILE_CALCHUMIDITY,
+  PROFILE_CALCDOWNFALL,
+  PROFILE_GENBIOME,
+  PROFILE_BIOMESUMMARY,
+  PROFILE_GENLOCAL,
+  PROFILE_DRAWWORLDMAP,
+  PROFILE_DRAWWORLDOVERLAY,
+  PROFILE_RENDERMAP,
+  PROFILE_RENDERLOCAL,
+  PROFILE_RENDERVEGETATION,
+  PROFILE_RENDERPLAYER,
+  PROFILE_STAGES
+};
+
+const std::array<std::string,PROFILE_STAGES> profileStrings {
+  "frame",
+  "genDepth",
+  "erode",
+  "calcFlow",
+  "calcAverage",
+  "climateDay",
+  "calcWind",
+  "calcTempMap",
+  "calcHumidityMap",
+  "calcDownfallMap",
+  "genBiome",
+  "biomeSummary",
+  "genLocal",
+  "drawWorldMap",
+  "drawWorldOverlay",
+  "renderMap",
+  "renderLocal",
+  "renderVegetation",
+  "renderPlayer"
+};
+
+class Profiler {
+  public:
+  //Rolling Window of Samples per Stage
+  static const int window = 512;
+
+  bool showHUD = false;
+
+  void record(int stage, double ms);
+  size_t count(int stage) const;
+  double mean(int stage) const;
+  //Sum over all Calls, not only the Window
+  double total(int stage) const;
+  //p from 0-1 over the Rolling Window
+  double percentile(int stage, double p) const;
+  void dump(std::ostream& out) const;
+
+  private:
+  struct Series {
+    float samples[window];
+    size_t count = 0;
+    double total = 0;
+  };
+  Series series[PROFILE_STAGES];
+  mutable std::mutex mutex;
+};
+
+extern Profiler profiler;
+
+//Records the Lifetime of the Scope into the Profiler (and the Tracer if enabled)
+class ScopedTimer {
+  public:
+  ScopedTimer(int stage);
+  ~ScopedTimer();
+  //Records the Stage before the Scope ends, later Calls do nothing
+  void stop();
+
+  private:
+  int stage;
+  bool traced;
+  bool running = true;
+  std::chrono::steady_clock::time_point start;
+};
+
+ScopedTimer::ScopedTimer(int stageIn) : stage(stageIn), traced(tracer.active()) {
+  if(traced) tracer.record(profileStrings[stage].c_str(), 'B');
+  start = std::chrono::steady_clock::now();
+}
+
+ScopedTimer::~ScopedTimer(){
+  stop();
+}
+
+void ScopedTimer::stop(){
+  if(!running) return;
+  running = false;
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now()-start;
+  profiler.record(stage, elapsed.count());
+  if(traced) tracer.record(profileStrings[stage].c_str(), 'E');
+}
+
+void Profiler::record(int stage, double ms){
+  std::lock_guard<std::mutex> lock(mutex);
+  Series& s = series[stage];
+  s.samples[s.count%window] = ms;
+  s.count++;
+  s.total += ms;
+}
+
+size_t Profiler::count(int stage) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return series[stage].count;
+}
+
+double Profiler::mean(int stage) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  const Series& s = series[stage];
+  if(s.count == 0) return 0;
+  return s.total/s.count;
+}
+
+double Profiler::total(int stage) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return series[stage].total;
+}
+
+double Profiler::percentile(int stage, double p) const {
+  float sorted[window];
+  size_t n = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Series& s = series[stage];
+    n = std::min(s.count, (size_t)window);
+    std::copy(s.samples, s.samples+n, sorted);
+  }
+  if(n == 0) return 0;
+
+  //Nearest Rank inside the Window
+  size_t rank = std::min((size_t)(p*n), n-1);
+  std::nth_element(sorted, sorted+rank, sorted+n);
+  return sorted[rank];
+}
+
+void Profiler::dump(std::ostream& out) const {
+  out << std::left << std::setw(18) << "stage" << std::right
+      << std::setw(10) << "calls" << std::setw(12) << "total ms"
+      << std::setw(10) << "mean" << std::setw(10) << "p50"
+      << std::setw(10) << "p95" << std::setw(10) << "p99" << std::endl;
+  for(int i = 0; i<PROFILE_STAGES; i++){
+    size_t n = count(i);
+    if(n == 0) continue;
+    out << std::left << std::setw(18) << profileStrings[i] << std::right << std::fixed << std::setprecision(3)
+        << std::setw(10) << n << std::setw(12) << mean(i)*n
+        << std::setw(10) << mean(i) << std::setw(10) << percentile(i, 0.5)
+        << std::setw(10) << percentile(i, 0.95) << std::setw(10) << percentile(i, 0.99) << std::endl;
+  }
+}
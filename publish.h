@@ -0,0 +1,92 @@
+//Live Climate Publication into POSIX Shared Memory
+//Readers in other Processes use ClimateShmReader from climateshm.h
+#include <string>
+#include "climateshm.h"
+
+class ClimatePublisher {
+  public:
+  //Creates (or replaces) the Segment, removed again on Destruction
+  ClimatePublisher(const std::string& name, size_t gridSize);
+  ~ClimatePublisher();
+
+  bool ok() const { return header != NULL; }
+  void publish(int day, const Climate& climate);
+
+  private:
+  std::string name;
+  size_t gridSize;
+  size_t bytes = 0;
+  ClimateShmHeader* header = NULL;
+  unsigned char* base = NULL;
+};
+
+ClimatePublisher::ClimatePublisher(const std::string& nameIn, size_t gridSizeIn) : name(nameIn), gridSize(gridSizeIn) {
+  const size_t slotBytes = climateShmSlotBytes(gridSize);
+  bytes = climateShmHeaderBytes()+2*slotBytes;
+  const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+  if(fd < 0){
+    std::cout<<"Couldn't create shared memory "<<name<<std::endl;
+    return;
+  }
+  if(ftruncate(fd, bytes) == 0){
+    void* mapped = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mapped != MAP_FAILED) base = (unsigned char*)mapped;
+  }
+  close(fd);
+  if(base == NULL){
+    std::cout<<"Couldn't map shared memory "<<name<<std::endl;
+    shm_unlink(name.c_str());
+    return;
+  }
+
+  header = (ClimateShmHeader*)base;
+  header->version = climateShmVersion;
+  header->gridSize = (uint32_t)gridSize;
+  header->slotCount = 2;
+  header->slotBytes = slotBytes;
+  for(int s = 0; s<2; s++){
+    header->slotOffset[s] = climateShmHeaderBytes()+s*slotBytes;
+    header->slot[s].sequence.store(0, std::memory_order_relaxed);
+  }
+  header->published.store(0, std::memory_order_relaxed);
+  //Readers check the Magic, so it goes in last
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(header->magic, "CLSH", 4);
+}
+
+ClimatePublisher::~ClimatePublisher(){
+  if(base == NULL) return;
+  munmap(base, bytes);
+  //Mapped Readers keep their View, new ones won't find a stale Segment
+  shm_unlink(name.c_str());
+}
+
+void ClimatePublisher::publish(int day, const Climate& climate){
+  if(header == NULL) return;
+  const uint64_t published = header->published.load(std::memory_order_relaxed);
+  const int s = (int)(published%2);
+  ClimateShmSlot& slot = header->slot[s];
+
+  //Odd Sequence while writing
+  const uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence+1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  const size_t gridSizeSq = gridSize*gridSize;
+  unsigned char* data = base+header->slotOffset[s];
+  memcpy(data, climate.TempMap, gridSizeSq*sizeof(float));
+  data += gridSizeSq*sizeof(float);
+  memcpy(data, climate.HumidityMap, gridSizeSq*sizeof(float));
+  data += gridSizeSq*sizeof(float);
+  memcpy(data, climate.WindMap, gridSizeSq*sizeof(float));
+  data += gridSizeSq*sizeof(float);
+  memcpy(data, climate.CloudMap, gridSizeSq);
+  data += gridSizeSq;
+  memcpy(data, climate.RainMap, gridSizeSq);
+  slot.day = day;
+  slot.windDirection[0] = climate.WindDirection[0];
+  slot.windDirection[1] = climate.WindDirection[1];
+
+  slot.sequence.store(sequence+2, std::memory_order_release);
+  header->published.store(published+1, std::memory_order_release);
+}
@@ -0,0 +1,147 @@
+//Regression Gate
+//Generates a fixed Set of Worlds, checks their Maps against a Baseline File and times every Stage.
+//Fails if a World changed or a Stage got slower than the Threshold allows.
+#include <map>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+struct RegressCase {
+  size_t gridSize;
+  int seed;
+};
+
+//The Standard Sizes, and a second Seed on the small Grid
+const RegressCase regressCases[] = { {100, 15}, {100, 1234}, {250, 15}, {500, 15} };
+//Days simulated after Generation, covers the live Step and the running Averages
+const int regressDays = 30;
+
+//Stages timed per Case, erode contains a calcAverage of its own
+const int regressStages[] = { PROFILE_GENDEPTH, PROFILE_ERODE, PROFILE_CALCAVERAGE, PROFILE_CALCFLOW, PROFILE_GENBIOME, PROFILE_CLIMATEDAY };
+
+class RegressionGate {
+  public:
+  //Fraction a Stage may be slower than its Baseline, and the Time below which Differences are Noise
+  double threshold = 0.2;
+  double noiseMS = 2;
+  //Timings are the best of this many Runs
+  int runs = 3;
+
+  //Compares against the Baseline, or writes it if there is none (or update is set). False on any Failure.
+  bool run(const std::string& path, bool update, std::ostream& out);
+
+  private:
+  //"<gridSize> <seed> <kind> <name>" -> Value
+  typedef std::map<std::string, std::string> Entries;
+
+  void measure(const RegressCase& c, Entries& entries, std::ostream& out);
+  static std::string key(const RegressCase& c, const char* kind, const std::string& name);
+  static std::string hex(uint64_t v);
+};
+
+std::string RegressionGate::key(const RegressCase& c, const char* kind, const std::string& name){
+  std::ostringstream s;
+  s << c.gridSize << " " << c.seed << " " << kind << " " << name;
+  return s.str();
+}
+
+std::string RegressionGate::hex(uint64_t v){
+  std::ostringstream s;
+  s << std::hex << std::setw(16) << std::setfill('0') << v;
+  return s.str();
+}
+
+void RegressionGate::measure(const RegressCase& c, Entries& entries, std::ostream& out){
+  const size_t gridSizeSq = c.gridSize*c.gridSize;
+  const int stages = sizeof(regressStages)/sizeof(regressStages[0]);
+  std::vector<double> best(stages, 1e30);
+  for(int r = 0; r<runs; r++){
+    std::vector<double> before(stages);
+    for(int s = 0; s<stages; s++) before[s] = profiler.total(regressStages[s]);
+
+    World world(c.gridSize, c.seed);
+    world.generate();
+    //The Maps Generation produced, before the live Days change the Averages
+    if(r == 0){
+      const Climate& a = world.climate;
+      entries[key(c, "hash", "depth")] = hex(fnv1a(world.terrain.depthMap, gridSizeSq*sizeof(float)));
+      entries[key(c, "hash", "biome")] = hex(fnv1a(world.terrain.biomeMap, gridSizeSq*sizeof(int)));
+      entries[key(c, "hash", "avgTemp")] = hex(fnv1a(a.AvgTempMap, gridSizeSq*sizeof(float)));
+      entries[key(c, "hash", "avgHumidity")] = hex(fnv1a(a.AvgHumidityMap, gridSizeSq*sizeof(float)));
+      entries[key(c, "hash", "avgWind")] = hex(fnv1a(a.AvgWindMap, gridSizeSq*sizeof(float)));
+      entries[key(c, "hash", "avgCloud")] = hex(fnv1a(a.AvgCloudMap, gridSizeSq*sizeof(float)));
+      entries[key(c, "hash", "avgRain")] = hex(fnv1a(a.AvgRainMap, gridSizeSq*sizeof(float)));
+    }
+    for(int d = 0; d<regressDays; d++) world.simulateDay();
+    if(r == 0) entries[key(c, "hash", "live")] = hex(world.checksum());
+
+    for(int s = 0; s<stages; s++) best[s] = std::min(best[s], profiler.total(regressStages[s])-before[s]);
+  }
+  for(int s = 0; s<stages; s++){
+    std::ostringstream ms;
+    ms << std::fixed << std::setprecision(3) << best[s];
+    entries[key(c, "ms", profileStrings[regressStages[s]])] = ms.str();
+  }
+  out << "Grid " << c.gridSize << ", seed " << c.seed << " measured" << std::endl;
+}
+
+bool RegressionGate::run(const std::string& path, bool update, std::ostream& out){
+  //Baselines are taken with Float Climate and the Cell Size of the Grid, as main() would set it
+  const ClimatePrecision precision = climatePrecision();
+  const int previousCellSize = cellSize;
+  climatePrecision() = PRECISION_FLOAT;
+
+  Entries measured;
+  for(size_t n = 0; n<sizeof(regressCases)/sizeof(regressCases[0]); n++){
+    cellSize = SCREEN_WIDTH/regressCases[n].gridSize;
+    measure(regressCases[n], measured, out);
+  }
+  climatePrecision() = precision;
+  cellSize = previousCellSize;
+
+  Entries baseline;
+  std::ifstream in(path.c_str());
+  std::string line;
+  while(std::getline(in, line)){
+    if(line.empty() || line[0] == '#') continue;
+    //The Value is the last Field
+    const size_t split = line.find_last_of(' ');
+    if(split != std::string::npos) baseline[line.substr(0, split)] = line.substr(split+1);
+  }
+
+  if(update || baseline.empty()){
+    std::ofstream file(path.c_str());
+    file << "#Territory Regression Baseline: <gridSize> <seed> hash|ms <name> <value>" << std::endl;
+    for(Entries::const_iterator it = measured.begin(); it != measured.end(); ++it)
+      file << it->first << " " << it->second << std::endl;
+    out << "Baseline written to " << path << std::endl;
+    return (bool)file;
+  }
+
+  bool pass = true;
+  for(Entries::const_iterator it = measured.begin(); it != measured.end(); ++it){
+    Entries::const_iterator base = baseline.find(it->first);
+    if(base == baseline.end()){
+      out << "MISSING " << it->first << " (not in baseline)" << std::endl;
+      pass = false;
+      continue;
+    }
+    if(it->first.find(" hash ") != std::string::npos){
+      if(it->second != base->second){
+        out << "DRIFT   " << it->first << ": " << base->second << " -> " << it->second << std::endl;
+        pass = false;
+      }
+      continue;
+    }
+    const double now = atof(it->second.c_str());
+    const double then = atof(base->second.c_str());
+    const bool slower = now > then*(1+threshold) && now-then > noiseMS;
+    out << (slower ? "SLOWER  " : "ok      ") << std::left << std::setw(28) << it->first << std::right << std::fixed << std::setprecision(1)
+        << std::setw(10) << then << " -> " << std::setw(10) << now << " ms (" << std::showpos << 100*(now-then)/std::max(then, 1e-9) << std::noshowpos << "%)" << std::endl;
+    if(slower) pass = false;
+  }
+  out << (pass ? "Regression gate passed" : "Regression gate FAILED") << std::endl;
+  return pass;
+}
@@ -0,0 +1,316 @@
+//Climate Record and Replay
+//Every Day is stored against the Day before: Float Maps quantized to 16 Bit and delta coded,
+//Cloud and Rain as Runs of changed Tiles. A Keyframe every few Days bounds the Cost of Seeking.
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+/*
+File Layout, little endian:
+char[4] "CLRP", uint32 version, uint32 gridSize, int32 seed, uint32 keyInterval, float windMin, float windMax
+Frames: char[4] "CLRF", int32 day, uint8 keyframe, double windDirection[2], uint32 payloadBytes, payload
+
+Payload: Temp, Humidity, Wind as zigzag varint Deltas of the quantized Values,
+then Cloud and Rain as varint Run Lengths of unchanged and changed Tiles, alternating.
+Keyframes are coded against zero.
+*/
+const uint32_t replayVersion = 1;
+
+class ReplayCodec {
+  public:
+  ReplayCodec(size_t gridSize, float windMin, float windMax);
+
+  //Codes the Day against the last one coded, or against zero
+  void encode(const Climate& climate, bool keyframe, std::vector<uint8_t>& out);
+  //Decodes the next Day into the Climate Maps, false if the Payload is damaged
+  bool decode(const uint8_t* data, size_t bytes, bool keyframe, Climate& climate);
+
+  private:
+  size_t gridSize;
+  float range[3][2];
+  std::vector<uint16_t> last[3];
+  std::vector<uint8_t> lastCloud;
+  std::vector<uint8_t> lastRain;
+
+  uint16_t quantize(int map, float v) const;
+  float restore(int map, uint16_t q) const;
+};
+
+ReplayCodec::ReplayCodec(size_t gridSizeIn, float windMin, float windMax) : gridSize(gridSizeIn) {
+  range[0][0] = 0; range[0][1] = 1;
+  range[1][0] = 0; range[1][1] = 1;
+  range[2][0] = windMin; range[2][1] = windMax;
+  for(int m = 0; m<3; m++) last[m].assign(gridSize*gridSize, 0);
+  lastCloud.assign(gridSize*gridSize, 0);
+  lastRain.assign(gridSize*gridSize, 0);
+}
+
+uint16_t ReplayCodec::quantize(int map, float v) const {
+  float t = (v-range[map][0])/(range[map][1]-range[map][0]);
+  t = std::min(std::max(t, 0.0f), 1.0f);
+  return (uint16_t)lrintf(t*65535);
+}
+
+float ReplayCodec::restore(int map, uint16_t q) const {
+  return range[map][0]+(range[map][1]-range[map][0])*(q/65535.0f);
+}
+
+void putVarint(std::vector<uint8_t>& out, uint32_t v){
+  while(v >= 0x80){
+    out.push_back((uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back((uint8_t)v);
+}
+
+bool getVarint(const uint8_t*& p, const uint8_t* end, uint32_t& v){
+  v = 0;
+  for(int shift = 0; p < end && shift < 35; shift += 7){
+    const uint8_t b = *p++;
+    v |= (uint32_t)(b & 0x7f) << shift;
+    if(!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+void ReplayCodec::encode(const Climate& climate, bool keyframe, std::vector<uint8_t>& out){
+  const size_t gridSizeSq = gridSize*gridSize;
+  const float* maps[3] = { climate.TempMap, climate.HumidityMap, climate.WindMap };
+  out.clear();
+  for(int m = 0; m<3; m++){
+    if(keyframe) std::fill(last[m].begin(), last[m].end(), 0);
+    for(size_t cell = 0; cell<gridSizeSq; cell++){
+      const uint16_t q = quantize(m, maps[m][cell]);
+      //Zigzag, small Steps either Way fit one Byte
+      const uint16_t delta = (uint16_t)(q-last[m][cell]);
+      putVarint(out, (uint16_t)((delta << 1) ^ (delta & 0x8000 ? 0xffff : 0)));
+      last[m][cell] = q;
+    }
+  }
+  const bool* bits[2] = { climate.CloudMap, climate.RainMap };
+  std::vector<uint8_t>* lastBits[2] = { &lastCloud, &lastRain };
+  for(int b = 0; b<2; b++){
+    std::vector<uint8_t>& prev = *lastBits[b];
+    if(keyframe) std::fill(prev.begin(), prev.end(), 0);
+    bool changed = false;
+    uint32_t run = 0;
+    for(size_t cell = 0; cell<gridSizeSq; cell++){
+      const uint8_t v = bits[b][cell];
+      if((v != prev[cell]) != changed){
+        putVarint(out, run);
+        changed = !changed;
+        run = 0;
+      }
+      run++;
+      prev[cell] = v;
+    }
+    putVarint(out, run);
+  }
+}
+
+bool ReplayCodec::decode(const uint8_t* data, size_t bytes, bool keyframe, Climate& climate){
+  const size_t gridSizeSq = gridSize*gridSize;
+  const uint8_t* p = data;
+  const uint8_t* end = data+bytes;
+  float* maps[3] = { climate.TempMap, climate.HumidityMap, climate.WindMap };
+  for(int m = 0; m<3; m++){
+    if(keyframe) std::fill(last[m].begin(), last[m].end(), 0);
+    for(size_t cell = 0; cell<gridSizeSq; cell++){
+      uint32_t z;
+      if(!getVarint(p, end, z)) return false;
+      const uint16_t delta = (uint16_t)((z >> 1) ^ (z & 1 ? 0xffff : 0));
+      last[m][cell] = (uint16_t)(last[m][cell]+delta);
+      maps[m][cell] = restore(m, last[m][cell]);
+    }
+  }
+  bool* bits[2] = { climate.CloudMap, climate.RainMap };
+  std::vector<uint8_t>* lastBits[2] = { &lastCloud, &lastRain };
+  for(int b = 0; b<2; b++){
+    std::vector<uint8_t>& prev = *lastBits[b];
+    if(keyframe) std::fill(prev.begin(), prev.end(), 0);
+    bool changed = false;
+    size_t cell = 0;
+    while(cell < gridSizeSq){
+      uint32_t run;
+      if(!getVarint(p, end, run) || run > gridSizeSq-cell) return false;
+      for(size_t n = cell; n<cell+run; n++){
+        if(changed) prev[n] ^= 1;
+        bits[b][n] = prev[n];
+      }
+      cell += run;
+      changed = !changed;
+    }
+  }
+  return p == end;
+}
+
+//Appends every recorded Day to a File
+class ClimateRecorder {
+  public:
+  ClimateRecorder(const std::string& path, const World& territory, int keyInterval);
+  void record(int day, const Climate& climate);
+  size_t bytes() const { return written; }
+
+  private:
+  std::ofstream out;
+  int keyInterval;
+  int frames = 0;
+  size_t written = 0;
+  ReplayCodec codec;
+  std::vector<uint8_t> payload;
+};
+
+//Wind can't leave the Range the Height Differences allow, see calcWindMap
+float windBound(const Terrain& terrain, int sign){
+  const size_t gridSizeSq = terrain.gridSize*terrain.gridSize;
+  const float spread = *std::max_element(terrain.depthMap, terrain.depthMap+gridSizeSq)
+                      -*std::min_element(terrain.depthMap, terrain.depthMap+gridSizeSq);
+  return 5*(1+sign*spread/1000);
+}
+
+ClimateRecorder::ClimateRecorder(const std::string& path, const World& territory, int keyIntervalIn) :
+  out(path.c_str(), std::ios::binary), keyInterval(std::max(1, keyIntervalIn)),
+  codec(territory.terrain.gridSize, windBound(territory.terrain, -1), windBound(territory.terrain, 1)) {
+  const float lo = windBound(territory.terrain, -1);
+  const float hi = windBound(territory.terrain, 1);
+  const uint32_t size = (uint32_t)territory.terrain.gridSize;
+  const int32_t seed = territory.seed;
+  const uint32_t interval = (uint32_t)keyInterval;
+  out.write("CLRP", 4);
+  out.write((const char*)&replayVersion, sizeof(replayVersion));
+  out.write((const char*)&size, sizeof(size));
+  out.write((const char*)&seed, sizeof(seed));
+  out.write((const char*)&interval, sizeof(interval));
+  out.write((const char*)&lo, sizeof(lo));
+  out.write((const char*)&hi, sizeof(hi));
+  written = 28;
+}
+
+void ClimateRecorder::record(int day, const Climate& climate){
+  const uint8_t keyframe = frames%keyInterval == 0;
+  codec.encode(climate, keyframe, payload);
+  const int32_t d = day;
+  const uint32_t bytes = (uint32_t)payload.size();
+  out.write("CLRF", 4);
+  out.write((const char*)&d, sizeof(d));
+  out.write((const char*)&keyframe, sizeof(keyframe));
+  out.write((const char*)climate.WindDirection, 2*sizeof(double));
+  out.write((const char*)&bytes, sizeof(bytes));
+  out.write((const char*)payload.data(), bytes);
+  written += 29+bytes;
+  frames++;
+}
+
+//Random Access to a recorded Run
+class ClimateReplay {
+  public:
+  ~ClimateReplay(){ delete codec; }
+
+  bool open(const std::string& path);
+  size_t frames() const { return index.size(); }
+  size_t gridSize() const { return size; }
+  int seed() const { return recordedSeed; }
+  int day(size_t frame) const { return index[frame].day; }
+
+  //Decodes a Frame into the Climate, stepping on from the current Frame if that is closer than a Keyframe
+  bool load(size_t frame, Climate& climate);
+
+  private:
+  struct Frame {
+    int day;
+    bool keyframe;
+    double windDirection[2];
+    size_t offset;
+    uint32_t bytes;
+  };
+  std::ifstream in;
+  std::vector<Frame> index;
+  std::vector<uint8_t> payload;
+  size_t size = 0;
+  int recordedSeed = 0;
+  ReplayCodec* codec = NULL;
+  //Frame the Codec State belongs to
+  long current = -1;
+
+  bool decode(size_t frame, Climate& climate);
+};
+
+bool ClimateReplay::open(const std::string& path){
+  in.open(path.c_str(), std::ios::binary | std::ios::ate);
+  const size_t fileBytes = (size_t)in.tellg();
+  in.seekg(0);
+  char magic[4];
+  uint32_t version, gridSize, interval;
+  int32_t seed;
+  float lo, hi;
+  in.read(magic, 4);
+  in.read((char*)&version, sizeof(version));
+  in.read((char*)&gridSize, sizeof(gridSize));
+  in.read((char*)&seed, sizeof(seed));
+  in.read((char*)&interval, sizeof(interval));
+  in.read((char*)&lo, sizeof(lo));
+  in.read((char*)&hi, sizeof(hi));
+  if(!in || memcmp(magic, "CLRP", 4) != 0 || version != replayVersion) return false;
+  size = gridSize;
+  recordedSeed = seed;
+  delete codec;
+  codec = new ReplayCodec(size, lo, hi);
+
+  //Index the Frames, a truncated last Frame is dropped
+  index.clear();
+  current = -1;
+  while(true){
+    Frame f;
+    int32_t day;
+    uint8_t keyframe;
+    in.read(magic, 4);
+    in.read((char*)&day, sizeof(day));
+    in.read((char*)&keyframe, sizeof(keyframe));
+    in.read((char*)f.windDirection, 2*sizeof(double));
+    in.read((char*)&f.bytes, sizeof(f.bytes));
+    if(!in || memcmp(magic, "CLRF", 4) != 0) break;
+    f.day = day;
+    f.keyframe = keyframe;
+    f.offset = (size_t)in.tellg();
+    if(f.offset+f.bytes > fileBytes) break;
+    index.push_back(f);
+    if(f.offset+f.bytes == fileBytes) break;
+    in.seekg(f.offset+f.bytes);
+  }
+  in.clear();
+  return !index.empty();
+}
+
+bool ClimateReplay::decode(size_t frame, Climate& climate){
+  const Frame& f = index[frame];
+  payload.resize(f.bytes);
+  in.seekg(f.offset);
+  in.read((char*)payload.data(), f.bytes);
+  if(!in || !codec->decode(payload.data(), f.bytes, f.keyframe, climate)){
+    in.clear();
+    current = -1;
+    return false;
+  }
+  climate.WindDirection[0] = f.windDirection[0];
+  climate.WindDirection[1] = f.windDirection[1];
+  current = (long)frame;
+  return true;
+}
+
+bool ClimateReplay::load(size_t frame, Climate& climate){
+  if(frame >= index.size()) return false;
+  if((long)frame == current) return true;
+  //Nearest Keyframe at or before the Frame
+  size_t start = frame;
+  while(start > 0 && !index[start].keyframe) start--;
+  //Continue from the current Frame if it lies between
+  if(current >= (long)start && current < (long)frame) start = current+1;
+  for(size_t n = start; n<=frame; n++)
+    if(!decode(n, climate)) return false;
+  climate.revision++;
+  return true;
+}
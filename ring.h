@@ -0,0 +1,33 @@
+//Single Producer, Single Consumer Ring
+#pragma once
+#include <atomic>
+#include <vector>
+
+//Lock-Free Ring for exactly one Producer and one Consumer Thread
+template<class T>
+class SpscRing {
+  public:
+  SpscRing(size_t capacity) : items(capacity+1) {}
+
+  bool push(const T& item){
+    const size_t h = head.load(std::memory_order_relaxed);
+    const size_t next = (h+1)%items.size();
+    if(next == tail.load(std::memory_order_acquire)) return false;
+    items[h] = item;
+    head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& item){
+    const size_t t = tail.load(std::memory_order_relaxed);
+    if(t == head.load(std::memory_order_acquire)) return false;
+    item = items[t];
+    tail.store((t+1)%items.size(), std::memory_order_release);
+    return true;
+  }
+
+  private:
+  std::vector<T> items;
+  std::atomic<size_t> head{0};
+  std::atomic<size_t> tail{0};
+};
@@ -0,0 +1,17 @@
+//Counter-Based Random Numbers
+//Every Draw is a pure Function of (seed, stage, counter), so it doesn't matter which Thread asks or in which Order
+#include <stdint.h>
+
+//Independent Streams for every Generation Stage
+enum RandomStage {
+  RANDOM_BIOME,
+  RANDOM_VEGETATION
+};
+
+//SplitMix64 Finalizer over the combined Key
+inline uint32_t cellRandom(int seed, int stage, uint64_t counter){
+  uint64_t z = counter+0x9E3779B97F4A7C15ull*((uint64_t)(uint32_t)seed*16+(uint32_t)stage+1);
+  z = (z^(z>>30))*0xBF58476D1CE4E5B9ull;
+  z = (z^(z>>27))*0x94D049BB133111EBull;
+  return (uint32_t)((z^(z>>31))>>32);
+}
@@ -0,0 +1,208 @@
+//Per Biome Climate Summaries
+//Area, Mean and Percentiles of the average Temperature, Humidity and Rain, and an Elevation Histogram for every Biome.
+//The Grid is cut into Bands of Rows, each Band keeps its own Histograms and every Worker fills whole Bands.
+//Counts and Sums are Integers, so the Totals are exact whatever the Worker Count, and a Band can be taken
+//back out of them and put in again when the live Simulation moved on.
+#include <stdint.h>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+
+enum SummaryField {
+  SUMMARY_TEMP,
+  SUMMARY_HUMIDITY,
+  SUMMARY_RAIN,
+  SUMMARY_FIELDS
+};
+
+const char* const summaryFieldNames[SUMMARY_FIELDS] = { "temp", "humidity", "rain" };
+
+class BiomeSummary {
+  public:
+  static const int biomes = 11;
+  //Bins over [0, 1] per Field, Rain is binned on its Square Root so Dry and Medium stay apart
+  static const int fieldBins = 256;
+  //Bins over [0, worldDepth]
+  static const int elevationBins = 40;
+  //Rows per Band
+  static const size_t bandRows = 16;
+
+  //Every Band from scratch
+  void compute(const World& world);
+  //The bands Bands refreshed longest ago, for the live Simulation. Falls back to compute on a new Grid.
+  void refresh(const World& world, size_t bands);
+
+  size_t area(int biome) const { return totals.area[biome]; }
+  double mean(int biome, SummaryField field) const;
+  //p in [0, 1], interpolated within the Bin
+  double percentile(int biome, SummaryField field, double p) const;
+  double meanElevation(int biome) const;
+  //elevationBins Counts, Bin b covers [b, b+1)*elevationStep() Meters
+  const uint32_t* elevation(int biome) const { return &totals.elevation[biome*elevationBins]; }
+  double elevationStep() const { return (double)worldDepth/elevationBins; }
+
+  void write(std::ostream& out) const;
+
+  private:
+  //Fixed Point of the Sums, Fields are in [0, 1] and Depths in Meters
+  static constexpr double fieldScale = 16777216.0;
+  static constexpr double depthScale = 256.0;
+
+  struct Accumulator {
+    std::vector<uint32_t> area;
+    //[biome][field][bin]
+    std::vector<uint32_t> fields;
+    //[biome][bin]
+    std::vector<uint32_t> elevation;
+    //[biome][field], Depth last
+    std::vector<uint64_t> sums;
+
+    void clear();
+    void add(const Accumulator& a);
+    void subtract(const Accumulator& a);
+  };
+
+  size_t gridSize = 0;
+  int worldDepth = 0;
+  std::vector<Accumulator> bands;
+  Accumulator totals;
+  //Next Band refresh() takes
+  size_t cursor = 0;
+
+  void resize(const World& world);
+  void accumulate(const World& world, size_t band);
+  static int bin(SummaryField field, float v);
+};
+
+void BiomeSummary::Accumulator::clear(){
+  area.assign(biomes, 0);
+  fields.assign(biomes*SUMMARY_FIELDS*fieldBins, 0);
+  elevation.assign(biomes*elevationBins, 0);
+  sums.assign(biomes*(SUMMARY_FIELDS+1), 0);
+}
+
+void BiomeSummary::Accumulator::add(const Accumulator& a){
+  for(size_t n = 0; n<area.size(); n++) area[n] += a.area[n];
+  for(size_t n = 0; n<fields.size(); n++) fields[n] += a.fields[n];
+  for(size_t n = 0; n<elevation.size(); n++) elevation[n] += a.elevation[n];
+  for(size_t n = 0; n<sums.size(); n++) sums[n] += a.sums[n];
+}
+
+void BiomeSummary::Accumulator::subtract(const Accumulator& a){
+  for(size_t n = 0; n<area.size(); n++) area[n] -= a.area[n];
+  for(size_t n = 0; n<fields.size(); n++) fields[n] -= a.fields[n];
+  for(size_t n = 0; n<elevation.size(); n++) elevation[n] -= a.elevation[n];
+  for(size_t n = 0; n<sums.size(); n++) sums[n] -= a.sums[n];
+}
+
+int BiomeSummary::bin(SummaryField field, float v){
+  v = std::min(std::max(v, 0.0f), 1.0f);
+  if(field == SUMMARY_RAIN) v = sqrtf(v);
+  return std::min((int)(v*fieldBins), fieldBins-1);
+}
+
+void BiomeSummary::resize(const World& world){
+  gridSize = world.terrain.gridSize;
+  worldDepth = world.terrain.worldDepth;
+  bands.resize((gridSize+bandRows-1)/bandRows);
+  for(size_t b = 0; b<bands.size(); b++) bands[b].clear();
+  totals.clear();
+  cursor = 0;
+}
+
+void BiomeSummary::accumulate(const World& world, size_t band){
+  const Terrain& terrain = world.terrain;
+  const Climate& climate = world.climate;
+  const float* maps[SUMMARY_FIELDS] = { climate.AvgTempMap, climate.AvgHumidityMap, climate.AvgRainMap };
+  Accumulator& a = bands[band];
+  a.clear();
+  const size_t end = std::min(gridSize, (band+1)*bandRows)*gridSize;
+  for(size_t cell = band*bandRows*gridSize; cell<end; cell++){
+    const int biome = terrain.biomeMap[cell];
+    if(biome < 0 || biome >= biomes) continue;
+    a.area[biome]++;
+    for(int f = 0; f<SUMMARY_FIELDS; f++){
+      const float v = maps[f][cell];
+      a.fields[(biome*SUMMARY_FIELDS+f)*fieldBins+bin((SummaryField)f, v)]++;
+      a.sums[biome*(SUMMARY_FIELDS+1)+f] += (uint64_t)llrint(std::min(std::max(v, 0.0f), 1.0f)*fieldScale);
+    }
+    const float depth = std::min(std::max(terrain.depthMap[cell], 0.0f), (float)worldDepth);
+    a.elevation[biome*elevationBins+std::min((int)(depth/worldDepth*elevationBins), elevationBins-1)]++;
+    a.sums[biome*(SUMMARY_FIELDS+1)+SUMMARY_FIELDS] += (uint64_t)llrint(depth*depthScale);
+  }
+}
+
+void BiomeSummary::compute(const World& world){
+  ScopedTimer timer(PROFILE_BIOMESUMMARY);
+  resize(world);
+  parallelRanges(bands.size(), 0, [&](size_t b0, size_t b1){
+    for(size_t b = b0; b<b1; b++) accumulate(world, b);
+  });
+  for(size_t b = 0; b<bands.size(); b++) totals.add(bands[b]);
+}
+
+void BiomeSummary::refresh(const World& world, size_t count){
+  if(gridSize != world.terrain.gridSize || bands.empty()){
+    compute(world);
+    return;
+  }
+  ScopedTimer timer(PROFILE_BIOMESUMMARY);
+  count = std::min(count, bands.size());
+  const size_t first = cursor;
+  for(size_t n = 0; n<count; n++) totals.subtract(bands[(first+n)%bands.size()]);
+  parallelRanges(count, 0, [&](size_t n0, size_t n1){
+    for(size_t n = n0; n<n1; n++) accumulate(world, (first+n)%bands.size());
+  });
+  for(size_t n = 0; n<count; n++) totals.add(bands[(first+n)%bands.size()]);
+  cursor = (first+count)%bands.size();
+}
+
+double BiomeSummary::mean(int biome, SummaryField field) const {
+  if(totals.area[biome] == 0) return 0;
+  return totals.sums[biome*(SUMMARY_FIELDS+1)+field]/fieldScale/totals.area[biome];
+}
+
+double BiomeSummary::meanElevation(int biome) const {
+  if(totals.area[biome] == 0) return 0;
+  return totals.sums[biome*(SUMMARY_FIELDS+1)+SUMMARY_FIELDS]/depthScale/totals.area[biome];
+}
+
+double BiomeSummary::percentile(int biome, SummaryField field, double p) const {
+  const size_t count = totals.area[biome];
+  if(count == 0) return 0;
+  const uint32_t* h = &totals.fields[(biome*SUMMARY_FIELDS+field)*fieldBins];
+  const double rank = std::min(std::max(p, 0.0), 1.0)*count;
+  double below = 0;
+  int b = 0;
+  while(b < fieldBins-1 && below+h[b] < rank) below += h[b++];
+  const double v = (b+(h[b] > 0 ? (rank-below)/h[b] : 0))/fieldBins;
+  return field == SUMMARY_RAIN ? v*v : v;
+}
+
+void BiomeSummary::write(std::ostream& out) const {
+  const size_t gridSizeSq = gridSize*gridSize;
+  out << std::left << std::setw(7) << "biome" << std::right << std::setw(9) << "area" << std::setw(8) << "%";
+  for(int f = 0; f<SUMMARY_FIELDS; f++)
+    out << std::setw(10) << summaryFieldNames[f] << std::setw(8) << "p10" << std::setw(8) << "p50" << std::setw(8) << "p90";
+  out << std::setw(10) << "depth" << std::endl;
+  for(int biome = 0; biome<biomes; biome++){
+    if(area(biome) == 0) continue;
+    out << std::left << std::setw(7) << biome << std::right << std::setw(9) << area(biome)
+        << std::fixed << std::setprecision(2) << std::setw(8) << 100.0*area(biome)/gridSizeSq << std::setprecision(4);
+    for(int f = 0; f<SUMMARY_FIELDS; f++){
+      const SummaryField field = (SummaryField)f;
+      out << std::setw(10) << mean(biome, field) << std::setw(8) << percentile(biome, field, 0.1)
+          << std::setw(8) << percentile(biome, field, 0.5) << std::setw(8) << percentile(biome, field, 0.9);
+    }
+    out << std::setprecision(1) << std::setw(10) << meanElevation(biome) << std::endl;
+  }
+  //Elevation Histograms, one Row per Biome, Bins with Cells only
+  out << "elevation histogram (" << elevationStep() << " m bins): biome bin:count ..." << std::endl;
+  for(int biome = 0; biome<biomes; biome++){
+    if(area(biome) == 0) continue;
+    out << biome;
+    for(int b = 0; b<elevationBins; b++)
+      if(elevation(biome)[b] > 0) out << " " << b << ":" << elevation(biome)[b];
+    out << std::endl;
+  }
+}
@@ -2,6 +2,14 @@
 
 //Using SDL and standard IO
 #include "view.h"
+#include "export.h"
+#include "publish.h"
+#include "worldmap.h"
+#include "replay.h"
+#include "regress.h"
+#include "tiles.h"
+#include "summary.h"
+#include "pacer.h"
 #include <stdio.h>
 #include <array>
 #include <iomanip>
@@ -22,9 +30,6 @@ Attempt to add Trees?
 */
 
 //Function Definitions
-void drawWorldMap(World* terrain, SDL_Renderer* gRenderer, Player* player, size_t gridSize);
-void drawWorldOverlay(World* terrain, SDL_Renderer* gRenderer, int a, size_t gridSize);
-
 bool loadMedia();
 
 std::array<std::string,10> modeStrings {
@@ -45,6 +50,8 @@ int cellSize = SCREEN_WIDTH / gridSizeDefault;
 int localGrid = 50;
 int seedDefault = 15;
 int seed = seedDefault;
+Profiler profiler;
+Tracer tracer;
 
 int main( int argc, char** args ) {
 	//The window we'll be rendering to
@@ -53,6 +60,12 @@ int main( int argc, char** args ) {
 
 	TTF_Init();
 
+	//Opt-in Trace Recording from Startup
+	if(getenv("TERRITORY_TRACE") != NULL){
+		tracer.start(getenv("TERRITORY_TRACE"));
+		tracer.nameThread("main");
+	}
+
 	size_t gridSize = gridSizeDefault;
 	if(argc>1)
 		gridSize = (size_t)atoi(args[1]);
@@ -60,9 +73,73 @@ int main( int argc, char** args ) {
 		localGrid = (size_t)atoi(args[2]);
 	if(argc>3)
 		seed = (size_t)atoi(args[3]);
-	gridSize=std::min(std::max(50ul,gridSize),1000ul);
+	gridSize=std::min(std::max(50ul,gridSize),2000ul);
 	localGrid=std::min(std::max(10ul,gridSize),100ul);
-	cellSize = SCREEN_WIDTH / gridSize;
+	//The World Map zooms on its own, past 1000 Cells this only keeps the Wind Schedule's Step whole
+	cellSize = std::max(1, SCREEN_WIDTH / (int)gridSize);
+
+	//Determinism Check without a Window: TERRITORY_VERIFY=<days>
+	if(getenv("TERRITORY_VERIFY") != NULL){
+		const bool same = verifyDeterminism(gridSize, seed, atoi(getenv("TERRITORY_VERIFY")));
+		std::cout<<(same ? "Generation is deterministic" : "Generation differs between worker counts")<<std::endl;
+		TTF_Quit();
+		return same ? 0 : 1;
+	}
+
+	//Regression Gate without a Window: TERRITORY_REGRESS=<baseline file>
+	if(getenv("TERRITORY_REGRESS") != NULL){
+		RegressionGate gate;
+		if(getenv("TERRITORY_REGRESS_THRESHOLD") != NULL)
+			gate.threshold = atof(getenv("TERRITORY_REGRESS_THRESHOLD"))/100;
+		if(getenv("TERRITORY_REGRESS_RUNS") != NULL)
+			gate.runs = std::max(1, atoi(getenv("TERRITORY_REGRESS_RUNS")));
+		const bool pass = gate.run(getenv("TERRITORY_REGRESS"), getenv("TERRITORY_REGRESS_UPDATE") != NULL, std::cout);
+		TTF_Quit();
+		return pass ? 0 : 1;
+	}
+
+	//Tile Pyramid of the generated World without a Window: TERRITORY_TILES=<dir>
+	if(getenv("TERRITORY_TILES") != NULL){
+		World world(gridSize, seed);
+		world.generate();
+		TileExporter tiles(&world, getenv("TERRITORY_TILES"));
+		if(getenv("TERRITORY_TILES_DETAIL") != NULL)
+			tiles.detailLevels = std::max(0, atoi(getenv("TERRITORY_TILES_DETAIL")));
+		const bool ok = tiles.run(std::cout);
+		TTF_Quit();
+		return ok ? 0 : 1;
+	}
+
+	//Per Biome Summary of the generated World without a Window: TERRITORY_SUMMARY=1
+	if(getenv("TERRITORY_SUMMARY") != NULL){
+		World world(gridSize, seed);
+		world.generate();
+		BiomeSummary summary;
+		summary.compute(world);
+		std::cout << "Grid " << gridSize << ", seed " << seed << std::endl;
+		summary.write(std::cout);
+		std::cout << "Summary took " << profiler.total(PROFILE_BIOMESUMMARY) << " ms" << std::endl;
+		TTF_Quit();
+		return 0;
+	}
+
+	//Seasonal Means over the Land without a Window: TERRITORY_CLIMATOLOGY=1, TERRITORY_PERIODS per Year (Months if unset)
+	if(getenv("TERRITORY_CLIMATOLOGY") != NULL){
+		if(seasonPeriods() == 0) seasonPeriods() = 12;
+		World world(gridSize, seed);
+		world.generate();
+		std::cout << "Grid " << gridSize << ", seed " << seed << ", " << world.climatology.periods << " periods" << std::endl;
+		world.climatology.write(std::cout, world.terrain.seaMap);
+		TTF_Quit();
+		return 0;
+	}
+
+	//Float against Fixed Point Climate without a Window: TERRITORY_PRECISION_REPORT=1
+	if(getenv("TERRITORY_PRECISION_REPORT") != NULL){
+		comparePrecision(gridSize, seed, std::cout);
+		TTF_Quit();
+		return 0;
+	}
 
 	//Initialize SDL
 	if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
@@ -80,7 +157,9 @@ int main( int argc, char** args ) {
 		else
 		{
 			//Prepare the Renderer
-		  gRenderer = SDL_CreateRenderer(gWindow, -1, SDL_RENDERER_ACCELERATED);
+			//TERRITORY_VSYNC=1 paces Frames by the Display, otherwise TERRITORY_FPS (default 60)
+			const bool vsync = getenv("TERRITORY_VSYNC") != NULL && atoi(getenv("TERRITORY_VSYNC")) != 0;
+		  gRenderer = SDL_CreateRenderer(gWindow, -1, SDL_RENDERER_ACCELERATED | (vsync ? SDL_RENDERER_PRESENTVSYNC : 0));
 
 			//Tiling Logic
 			View view(gridSize);
@@ -93,6 +172,47 @@ int main( int argc, char** args ) {
 			Player* player = new Player();
 
 			territory->generate();
+			//Per Biome Summary, a few Bands of Rows fresh every Day
+			BiomeSummary summary;
+			summary.compute(*territory);
+			const size_t summaryBands = 4;
+
+			//Opt-in Climate Time-Series Export
+			ClimateExporter* exporter = NULL;
+			if(getenv("TERRITORY_EXPORT") != NULL){
+				int frameInterval = 0;
+				if(getenv("TERRITORY_EXPORT_FRAMES") != NULL)
+					frameInterval = atoi(getenv("TERRITORY_EXPORT_FRAMES"));
+				exporter = new ClimateExporter(getenv("TERRITORY_EXPORT"), gridSize, frameInterval);
+			}
+			//Opt-in Live Climate for other Processes
+			ClimatePublisher* publisher = NULL;
+			if(getenv("TERRITORY_SHM") != NULL){
+				publisher = new ClimatePublisher(getenv("TERRITORY_SHM"), gridSize);
+			}
+			//Opt-in Recording of every simulated Day: TERRITORY_RECORD=<file>, Keyframe every TERRITORY_RECORD_KEYFRAME Days
+			ClimateRecorder* recorder = NULL;
+			if(getenv("TERRITORY_RECORD") != NULL){
+				int keyInterval = 30;
+				if(getenv("TERRITORY_RECORD_KEYFRAME") != NULL)
+					keyInterval = atoi(getenv("TERRITORY_RECORD_KEYFRAME"));
+				recorder = new ClimateRecorder(getenv("TERRITORY_RECORD"), *territory, keyInterval);
+			}
+			//Replay a Recording instead of simulating: TERRITORY_REPLAY=<file>
+			ClimateReplay* replay = NULL;
+			long replayFrame = 0;
+			bool replayPlaying = true;
+			if(getenv("TERRITORY_REPLAY") != NULL){
+				replay = new ClimateReplay();
+				if(!replay->open(getenv("TERRITORY_REPLAY")) || replay->gridSize() != gridSize){
+					std::cout<<"Couldn't replay "<<getenv("TERRITORY_REPLAY")<<std::endl;
+					delete replay;
+					replay = NULL;
+				}
+				else if(replay->seed() != seed){
+					std::cout<<"Recording was made with seed "<<replay->seed()<<std::endl;
+				}
+			}
 			//Clear the Screen
 			SDL_SetRenderDrawBlendMode(gRenderer,SDL_BLENDMODE_BLEND);
 
@@ -100,10 +220,21 @@ int main( int argc, char** args ) {
 			bool quit = false;
 			SDL_Event e;
 			int overlayMode = 0;
+			//Overlays added with Shift
+			unsigned int extraOverlays = 0;
+			WorldMap worldMap;
+			//Milliseconds per simulated Day
 			int delayMS = 100;
+			int fps = 60;
+			if(getenv("TERRITORY_FPS") != NULL)
+				fps = std::min(std::max(atoi(getenv("TERRITORY_FPS")), 1), 1000);
+			FramePacer pacer(vsync ? 0 : 1000.0/fps, delayMS);
 
 			while(!quit){
+				ScopedTimer frameTimer(PROFILE_FRAME);
 				//Check for Quit
+				const bool pollTraced = tracer.active();
+				if(pollTraced) tracer.record("pollEvents", 'B');
 				while( SDL_PollEvent( &e ) != 0 ) {
 					//User requests quit
 					if( e.type == SDL_QUIT ) { quit = true; }
@@ -131,10 +262,48 @@ int main( int argc, char** args ) {
 						else if (e.key.keysym.sym == SDLK_r){
 							view.rotateView();
 						}
+						else if (e.key.keysym.sym == SDLK_p){
+							profiler.showHUD = !profiler.showHUD;
+						}
+						//Tracing: T starts recording, T again writes the Trace
+						else if (e.key.keysym.sym == SDLK_t){
+							if(!tracer.active()){
+								tracer.start("");
+								tracer.nameThread("main");
+								std::cout << "Tracing started" << std::endl;
+							}
+							else{
+								tracer.stop();
+								if(tracer.write()) std::cout << "Trace written to " << tracer.path << std::endl;
+								else std::cout << "Couldn't write " << tracer.path << std::endl;
+							}
+						}
+						else if (e.key.keysym.sym == SDLK_b){
+							std::cout << "Day " << territory->day << std::endl;
+							summary.write(std::cout);
+						}
+						else if (e.key.keysym.sym >= SDLK_0 && e.key.keysym.sym <= SDLK_9 && (e.key.keysym.mod & KMOD_SHIFT)){
+							extraOverlays ^= 1u<<(e.key.keysym.sym-SDLK_0);
+						}
 						else if (e.key.keysym.sym >= SDLK_0 && e.key.keysym.sym <= SDLK_9){
 							overlayMode = e.key.keysym.sym-SDLK_0;
 							std::cout << "Overlay " << overlayMode << " " << modeStrings[overlayMode] << std::endl;
 						}
+						//Replay Scrubbing: Comma and Period step a Day (a Month with Shift), Return pauses
+						if(replay != NULL && view.viewMode == 0){
+							const long step = (e.key.keysym.mod & KMOD_SHIFT) ? 30 : 1;
+							if(e.key.keysym.sym == SDLK_COMMA){
+								replayFrame = std::max(replayFrame-step, 0l);
+								replayPlaying = false;
+							}
+							else if(e.key.keysym.sym == SDLK_PERIOD){
+								replayFrame = std::min(replayFrame+step, (long)replay->frames()-1);
+								replayPlaying = false;
+							}
+							else if(e.key.keysym.sym == SDLK_RETURN){
+								replayPlaying = !replayPlaying;
+							}
+						}
 						if(view.viewMode == 1){
 							territory->changePos(e);
 						}
@@ -142,42 +311,76 @@ int main( int argc, char** args ) {
 							player->changePos(e);
 						}
 					}
+					//Zoom and Pan
+					if(view.viewMode == 0){
+						worldMap.handleEvent(e);
+					}
 				}
+				if(pollTraced) tracer.record("pollEvents", 'E');
 
 				SDL_SetRenderDrawColor(gRenderer, 0, 0, 0, 0);
 				SDL_RenderClear(gRenderer);
+				pacer.stepMS = delayMS;
 				if(view.viewMode == 0){
-					territory->day+=1;
-					territory->climate.calcWind(territory->day, territory->seed, &territory->terrain);
-					territory->climate.calcTempMap(&territory->terrain);
-					territory->climate.calcHumidityMap(&territory->terrain);
-					territory->climate.calcDownfallMap();
+					//As many Days as the Time since the last Frame holds
+					const int steps = pacer.steps();
+					for(int step = 0; step<steps && !(step > 0 && pacer.late()); step++){
+						if(replay != NULL){
+							if(replayPlaying && replayFrame+1 < (long)replay->frames()) replayFrame++;
+							if(replay->load(replayFrame, territory->climate)) territory->day = replay->day(replayFrame);
+						}
+						else{
+							territory->simulateDay();
+							if(recorder != NULL) recorder->record(territory->day, territory->climate);
+						}
+						if(exporter != NULL) exporter->record(territory->day, territory->climate);
+						if(publisher != NULL) publisher->publish(territory->day, territory->climate);
+						summary.refresh(*territory, summaryBands);
+					}
+					//Scrubbed Frames show at once, paused or not
+					if(replay != NULL && replay->load(replayFrame, territory->climate)) territory->day = replay->day(replayFrame);
 
 					//I don't know why this works
-					drawWorldMap(territory, gRenderer, player, gridSize);
-					drawWorldOverlay(territory, gRenderer,overlayMode, gridSize);
+					unsigned int overlays = (1u<<overlayMode) | extraOverlays;
 					if(overlayMode==1) // wind and clouds drawn together
-						drawWorldOverlay(territory, gRenderer,overlayMode+1, gridSize);
-
-					//Wait for day development
-					//view.calcFPS();
-					SDL_Delay(delayMS);
+						overlays |= 1u<<(overlayMode+1);
+					worldMap.render(territory, gRenderer, player, overlays);
+					view.renderStatus(gRenderer, territory->day, modeStrings[overlayMode], 1000.0f/(float)delayMS);
 				}
 
 				else if(view.viewMode == 1){
+					pacer.hold();
 					view.renderMap(territory, gRenderer, territory->xview, territory->yview);
-					//view.calcFPS();
 				}
 
 				else if(view.viewMode == 2){
+					pacer.hold();
 					view.renderLocal(territory, gRenderer, player);
-					//view.calcFPS();
-					SDL_Delay(10);
 				}
 				//Draw Everything
-				SDL_RenderPresent(gRenderer);
+				view.renderProfiler(gRenderer);
+				{
+					TraceScope presentTrace("present");
+					SDL_RenderPresent(gRenderer);
+				}
+				//The Frame's Work ends here, the Sleep is pacing and not counted
+				frameTimer.stop();
+				//Sleep until the next Frame is due
+				TraceScope delayTrace("delay");
+				pacer.wait();
+			}
+			profiler.dump(std::cout);
+			memoryLedger().dump(std::cout);
+			if(tracer.active()){
+				tracer.stop();
+				if(tracer.write()) std::cout << "Trace written to " << tracer.path << std::endl;
 			}
 
+			delete exporter;
+			delete recorder;
+			delete replay;
+			delete publisher;
+			view.detach();
 			delete player;
 			delete territory;
 		}
@@ -192,111 +395,3 @@ int main( int argc, char** args ) {
 
 	return 0;
 }
-
-void drawWorldMap(World* territory, SDL_Renderer* gRenderer, Player* player, size_t gridSize){
-	//Draw the Map with Overlays
-	for (size_t i=0; i<gridSize; i++){
-		for (size_t j=0; j<gridSize; j++){
-			int a = territory->terrain.biomeMap[i*gridSize+j];
-			SDL_Rect rect;
-			rect.x=i*cellSize;
-			rect.y=j*cellSize;
-			rect.w=cellSize;
-			rect.h=cellSize;
-			switch(a){
-				//Water
-				case 0: SDL_SetRenderDrawColor(gRenderer, 0x2d, 0x56, 0x85, 255);
-				break;
-				//Sandy Beach
-				case 1: SDL_SetRenderDrawColor(gRenderer, 0xea, 0xdf, 0x9e, 255);
-				break;
-				//Gravel Beach
-				case 2: SDL_SetRenderDrawColor(gRenderer, 0xcc, 0xcc, 0xcc, 255);
-				break;
-				//Stoney Beach Cliff
-				case 3: SDL_SetRenderDrawColor(gRenderer, 0xa7, 0xa5, 0x9b, 255);
-				break;
-				//Wet Plains (Grassland)
-				case 4: SDL_SetRenderDrawColor(gRenderer, 0x9e, 0xc1, 0x6d, 255);
-				break;
-				//Dry Plains (Shrubland)
-				case 5: SDL_SetRenderDrawColor(gRenderer, 0xbc, 0xc1, 0x6d, 255);
-				break;
-				//Rocky Hills
-				case 6: SDL_SetRenderDrawColor(gRenderer, 0xaa, 0xaa, 0xaa, 255);
-				break;
-				//Temperate Forest
-				case 7: SDL_SetRenderDrawColor(gRenderer, 0x3d, 0xab, 0x50, 255);
-				break;
-				//Boreal Forest
-				case 8: SDL_SetRenderDrawColor(gRenderer, 0x30, 0x7a, 0x3c, 255);
-				break;
-				//Mountain Tundra
-				case 9: SDL_SetRenderDrawColor(gRenderer, 0x77, 0x77, 0x77, 255);
-				break;
-				//Mountain Peak
-				case 10: SDL_SetRenderDrawColor(gRenderer, 0xee, 0xee, 0xee, 255);
-			}
-			SDL_RenderFillRect(gRenderer, &rect);
-		}
-	}
-	SDL_SetRenderDrawColor(gRenderer, 0xee, 0x11, 0x11, 255);
-	SDL_Rect rect;
-	rect.x=player->xGlobal*cellSize;
-	rect.y=player->yGlobal*cellSize;
-	rect.w=cellSize;
-	rect.h=cellSize;
-	SDL_RenderFillRect(gRenderer, &rect);
-}
-
-void drawWorldOverlay(World* territory, SDL_Renderer* gRenderer, int a, size_t gridSize){
-	//Draw the Climate Map
-	for(size_t i = 0; i<gridSize; i++){
-		for(size_t j = 0; j<gridSize; j++){
-			const size_t cell = i*gridSize+j;
-			
-			//std::cout<<territory.climate.AvgRainMap[i][j]<<std::endl;
-			//Drawing Rectangle
-			SDL_Rect rect;
-			rect.x=i*cellSize;
-			rect.y=j*cellSize;
-			rect.w=cellSize;
-			rect.h=cellSize;
-			//Render the Overlays
-			switch(a){
-				//Wind Map
-				case 0: SDL_SetRenderDrawColor(gRenderer, territory->climate.WindMap[cell]*25, territory->climate.WindMap[cell]*25, territory->climate.WindMap[cell]*25, 100);
-					break;
-				//Cloud Map
-				case 1: SDL_SetRenderDrawColor(gRenderer, 255, 255, 255, 100*territory->climate.CloudMap[cell]);
-					break;
-				//Rain Map
-				case 2: SDL_SetRenderDrawColor(gRenderer, 255, 255, 255, 255*territory->climate.RainMap[cell]);
-					break;
-				//Temperature Map
-				case 3: SDL_SetRenderDrawColor(gRenderer, territory->climate.TempMap[cell]*255, 150, 150, 100);
-					break;
-				//Humidity Map
-				case 4: SDL_SetRenderDrawColor(gRenderer, 50, 50, territory->climate.HumidityMap[cell]*255, 220);
-					break;
-				//Average Wind Map
-				case 5: SDL_SetRenderDrawColor(gRenderer, 255, 255, 255, ((5-territory->climate.AvgWindMap[cell])+2)*60);
-					break;
-				//Average Cloud Map
-				case 6: SDL_SetRenderDrawColor(gRenderer, 255, 255, 255, 255*territory->climate.AvgCloudMap[cell]);
-					break;
-				//Average Rain Map
-				case 7: SDL_SetRenderDrawColor(gRenderer, 255, 255, 255, 255*10*territory->climate.AvgRainMap[cell]);
-					break;
-				//Average Temperature Map
-				case 8: SDL_SetRenderDrawColor(gRenderer, territory->climate.AvgTempMap[cell]*255, 150, 150, 100);
-					break;
-				//Average Humidity Map
-				case 9: SDL_SetRenderDrawColor(gRenderer, 50, 50, territory->climate.AvgHumidityMap[cell]*255, 220);
-					break;
-
-			}
-			SDL_RenderFillRect(gRenderer, &rect);
-		}
-	}
-}
@@ -0,0 +1,168 @@
+//Glyph Atlas Text Rendering
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+//Printable ASCII, rendered once into one Texture per Font Size
+class GlyphAtlas {
+  public:
+  ~GlyphAtlas();
+
+  bool build(SDL_Renderer* gRenderer, const char* path, int size);
+  //Renders the Glyphs into a Surface the Caller owns, to be packed into a shared Texture
+  SDL_Surface* render(const char* path, int size);
+  //Draw from a Region of a Texture the Atlas does not own
+  void attach(SDL_Texture* shared, const SDL_Rect& region, int textureWidth, int textureHeight);
+  int lineHeight() const { return height; }
+
+  //Queue Text for the next flush, Static Strings are laid out once and cached
+  void add(const char* text, int x, int y, SDL_Color color);
+  void addStatic(const std::string& text, int x, int y, SDL_Color color);
+  //One Draw Call for everything queued
+  void flush(SDL_Renderer* gRenderer);
+
+  private:
+  static const int firstGlyph = 32;
+  static const int glyphCount = 95;
+  struct Glyph {
+    SDL_Rect rect = {0,0,0,0};
+    int advance = 0;
+  };
+  Glyph glyphs[glyphCount];
+  SDL_Texture* texture = NULL;
+  bool ownsTexture = false;
+  //Placement of the Glyphs inside the Texture
+  int originX = 0;
+  int originY = 0;
+  int width = 0;
+  int atlasHeight = 0;
+  int height = 0;
+
+  std::vector<SDL_Vertex> vertices;
+  std::vector<int> indices;
+  std::unordered_map<std::string, std::vector<SDL_Vertex> > cache;
+
+  void layout(const char* text, int x, int y, SDL_Color color, std::vector<SDL_Vertex>& out) const;
+};
+
+GlyphAtlas::~GlyphAtlas(){
+  if(ownsTexture && texture != NULL) SDL_DestroyTexture(texture);
+}
+
+SDL_Surface* GlyphAtlas::render(const char* path, int size){
+  TTF_Font* font = TTF_OpenFont(path, size);
+  if(font == NULL) return NULL;
+  height = TTF_FontHeight(font);
+
+  //Render every Glyph and pack them into Rows
+  const int atlasWidth = 512;
+  SDL_Color white = { 255, 255, 255, 255 };
+  SDL_Surface* rendered[glyphCount];
+  int x = 0, y = 0;
+  for(int g = 0; g<glyphCount; g++){
+    rendered[g] = TTF_RenderGlyph_Blended(font, (Uint16)(firstGlyph+g), white);
+    int minx, maxx, miny, maxy;
+    TTF_GlyphMetrics(font, (Uint16)(firstGlyph+g), &minx, &maxx, &miny, &maxy, &glyphs[g].advance);
+    if(rendered[g] == NULL) continue;
+    if(x+rendered[g]->w > atlasWidth){
+      x = 0;
+      y += height+1;
+    }
+    glyphs[g].rect.x = x;
+    glyphs[g].rect.y = y;
+    glyphs[g].rect.w = rendered[g]->w;
+    glyphs[g].rect.h = rendered[g]->h;
+    x += rendered[g]->w+1;
+  }
+  TTF_CloseFont(font);
+
+  SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(0, atlasWidth, y+height+1, 32, SDL_PIXELFORMAT_RGBA32);
+  for(int g = 0; g<glyphCount; g++){
+    if(rendered[g] == NULL) continue;
+    if(atlas != NULL){
+      SDL_SetSurfaceBlendMode(rendered[g], SDL_BLENDMODE_NONE);
+      SDL_BlitSurface(rendered[g], NULL, atlas, &glyphs[g].rect);
+    }
+    SDL_FreeSurface(rendered[g]);
+  }
+  return atlas;
+}
+
+bool GlyphAtlas::build(SDL_Renderer* gRenderer, const char* path, int size){
+  SDL_Surface* atlas = render(path, size);
+  if(atlas == NULL) return false;
+  SDL_Texture* own = SDL_CreateTextureFromSurface(gRenderer, atlas);
+  SDL_Rect region = { 0, 0, atlas->w, atlas->h };
+  SDL_FreeSurface(atlas);
+  if(own == NULL) return false;
+  SDL_SetTextureBlendMode(own, SDL_BLENDMODE_BLEND);
+  attach(own, region, region.w, region.h);
+  ownsTexture = true;
+  return true;
+}
+
+void GlyphAtlas::attach(SDL_Texture* shared, const SDL_Rect& region, int textureWidth, int textureHeight){
+  if(ownsTexture && texture != NULL) SDL_DestroyTexture(texture);
+  ownsTexture = false;
+  texture = shared;
+  originX = region.x;
+  originY = region.y;
+  width = textureWidth;
+  atlasHeight = textureHeight;
+}
+
+void GlyphAtlas::layout(const char* text, int x, int y, SDL_Color color, std::vector<SDL_Vertex>& out) const {
+  int pen = x;
+  for(const char* c = text; *c; c++){
+    const int g = (unsigned char)*c-firstGlyph;
+    if(g < 0 || g >= glyphCount) continue;
+    const SDL_Rect& r = glyphs[g].rect;
+    if(r.w > 0){
+      //Quad Corners: Top Left, Top Right, Bottom Right, Bottom Left
+      const float u0 = (float)(originX+r.x)/width, u1 = (float)(originX+r.x+r.w)/width;
+      const float v0 = (float)(originY+r.y)/atlasHeight, v1 = (float)(originY+r.y+r.h)/atlasHeight;
+      SDL_Vertex v;
+      v.color = color;
+      v.position.x = pen;     v.position.y = y;     v.tex_coord.x = u0; v.tex_coord.y = v0; out.push_back(v);
+      v.position.x = pen+r.w; v.position.y = y;     v.tex_coord.x = u1; v.tex_coord.y = v0; out.push_back(v);
+      v.position.x = pen+r.w; v.position.y = y+r.h; v.tex_coord.x = u1; v.tex_coord.y = v1; out.push_back(v);
+      v.position.x = pen;     v.position.y = y+r.h; v.tex_coord.x = u0; v.tex_coord.y = v1; out.push_back(v);
+    }
+    pen += glyphs[g].advance;
+  }
+}
+
+void GlyphAtlas::add(const char* text, int x, int y, SDL_Color color){
+  if(texture == NULL) return;
+  layout(text, x, y, color, vertices);
+}
+
+void GlyphAtlas::addStatic(const std::string& text, int x, int y, SDL_Color color){
+  if(texture == NULL) return;
+  std::unordered_map<std::string, std::vector<SDL_Vertex> >::iterator it = cache.find(text);
+  if(it == cache.end()){
+    it = cache.insert(std::make_pair(text, std::vector<SDL_Vertex>())).first;
+    layout(text.c_str(), 0, 0, { 255, 255, 255, 255 }, it->second);
+  }
+  //Cached at the Origin, moved into Place
+  for(size_t n = 0; n<it->second.size(); n++){
+    SDL_Vertex v = it->second[n];
+    v.position.x += x;
+    v.position.y += y;
+    v.color = color;
+    vertices.push_back(v);
+  }
+}
+
+void GlyphAtlas::flush(SDL_Renderer* gRenderer){
+  if(vertices.empty()) return;
+  //Two Triangles per Quad, the Index Pattern only ever grows
+  const size_t quads = vertices.size()/4;
+  for(size_t q = indices.size()/6; q<quads; q++){
+    const int base = (int)q*4;
+    const int quad[6] = { base, base+1, base+2, base, base+2, base+3 };
+    indices.insert(indices.end(), quad, quad+6);
+  }
+  SDL_RenderGeometry(gRenderer, texture, vertices.data(), (int)vertices.size(), indices.data(), (int)quads*6);
+  vertices.clear();
+}
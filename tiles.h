@@ -0,0 +1,208 @@
+//Tile Pyramid Export for Web Maps
+//Every Layer is cut into square PNG Tiles per Zoom Level, <dir>/<layer>/<z>/<x>/<y>.png, x along i.
+//Levels finer than the Grid take their Detail from the Perlin Terrain behind genDepth.
+//Tiles are rendered and encoded on the Worker Pool, and Tiles whose Pixels are unchanged since the last Export are not written again.
+#include <sys/stat.h>
+#include <atomic>
+#include <map>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+
+enum TileLayer {
+  TILE_BIOME,
+  TILE_DEPTH,
+  TILE_AVGTEMP,
+  TILE_AVGHUMIDITY,
+  TILE_AVGRAIN,
+  TILE_LAYERS
+};
+
+const char* const tileLayerNames[TILE_LAYERS] = { "biome", "depth", "temp", "humidity", "rain" };
+
+class TileExporter {
+  public:
+  TileExporter(const World* territory, const std::string& dir);
+
+  int tileSize = 256;
+  //Zoom Levels past the first one with at least a Pixel per Grid Cell
+  int detailLevels = 2;
+
+  //Writes every Level, false if a Tile couldn't be written
+  bool run(std::ostream& out);
+
+  private:
+  struct Tile {
+    int z, x, y;
+  };
+  const World* territory;
+  std::string dir;
+  //Depth minus the uneroded Noise per Cell, so Detail Levels keep the Erosion
+  std::vector<float> erosion;
+
+  int levels() const;
+  std::string path(int layer, const Tile& t) const;
+  void render(const Tile& t, const module::Perlin& perlin, std::vector<Uint8>* pixels) const;
+  float bilinear(const float* map, float ci, float cj) const;
+  static SDL_Color depthColor(float depth);
+  static SDL_Color ramp(float v, SDL_Color lo, SDL_Color hi);
+};
+
+TileExporter::TileExporter(const World* territoryIn, const std::string& dirIn) : territory(territoryIn), dir(dirIn) {
+  const Terrain& terrain = territory->terrain;
+  const size_t gridSize = terrain.gridSize;
+  erosion.resize(gridSize*gridSize);
+  parallelRanges(gridSize, 0, [&](size_t i0, size_t i1){
+    module::Perlin perlin = {};
+    Terrain::depthNoise(perlin);
+    for(size_t i = i0; i<i1; i++){
+      for(size_t j = 0; j<gridSize; j++){
+        erosion[i*gridSize+j] = terrain.depthMap[i*gridSize+j]-terrain.noiseDepth(perlin, i, j);
+      }
+    }
+  });
+}
+
+int TileExporter::levels() const {
+  int native = 0;
+  while(((size_t)tileSize<<native) < territory->terrain.gridSize) native++;
+  return native+detailLevels+1;
+}
+
+std::string TileExporter::path(int layer, const Tile& t) const {
+  std::ostringstream s;
+  s << tileLayerNames[layer] << "/" << t.z << "/" << t.x << "/" << t.y << ".png";
+  return s.str();
+}
+
+float TileExporter::bilinear(const float* map, float ci, float cj) const {
+  const int gridSize = (int)territory->terrain.gridSize;
+  int i = std::min(std::max((int)floorf(ci), 0), gridSize-2);
+  int j = std::min(std::max((int)floorf(cj), 0), gridSize-2);
+  const float t = std::min(std::max(ci-i, 0.0f), 1.0f);
+  const float u = std::min(std::max(cj-j, 0.0f), 1.0f);
+  const float* c = map+i*gridSize+j;
+  return (1-t)*((1-u)*c[0]+u*c[1]) + t*((1-u)*c[gridSize]+u*c[gridSize+1]);
+}
+
+SDL_Color TileExporter::ramp(float v, SDL_Color lo, SDL_Color hi){
+  v = std::min(std::max(v, 0.0f), 1.0f);
+  return { channel(lo.r+(hi.r-lo.r)*v), channel(lo.g+(hi.g-lo.g)*v), channel(lo.b+(hi.b-lo.b)*v), 255 };
+}
+
+SDL_Color TileExporter::depthColor(float depth){
+  //Deep to shallow Water, then Lowland to Peak
+  if(depth <= 200) return ramp(depth/200, { 0x10, 0x2a, 0x50, 255 }, { 0x3b, 0x6e, 0xa5, 255 });
+  if(depth <= 1200) return ramp((depth-200)/1000, { 0x6d, 0x9c, 0x4a, 255 }, { 0x9c, 0x8a, 0x5c, 255 });
+  return ramp((depth-1200)/1000, { 0x9c, 0x8a, 0x5c, 255 }, { 0xf0, 0xf0, 0xf0, 255 });
+}
+
+void TileExporter::render(const Tile& t, const module::Perlin& perlin, std::vector<Uint8>* pixels) const {
+  const Terrain& terrain = territory->terrain;
+  const Climate& climate = territory->climate;
+  const int gridSize = (int)terrain.gridSize;
+  //Grid Cells per Pixel on this Level
+  const float scale = (float)gridSize/((size_t)tileSize<<t.z);
+  const bool detail = scale < 1;
+  for(int py = 0; py<tileSize; py++){
+    for(int px = 0; px<tileSize; px++){
+      //Pixel Center in Cell Coordinates, Cell Centers at whole Numbers
+      const float ci = ((float)t.x*tileSize+px+0.5f)*scale-0.5f;
+      const float cj = ((float)t.y*tileSize+py+0.5f)*scale-0.5f;
+      const int i = std::min(std::max((int)lrintf(ci), 0), gridSize-1);
+      const int j = std::min(std::max((int)lrintf(cj), 0), gridSize-1);
+      const size_t cell = i*gridSize+j;
+
+      const float depth = detail ? terrain.noiseDepth(perlin, ci, cj)+bilinear(erosion.data(), ci, cj)
+                                 : bilinear(terrain.depthMap, ci, cj);
+      //Coast Lines follow the finer Depth
+      int biome = terrain.biomeMap[cell];
+      if(detail && depth <= 200) biome = 0;
+      else if(detail && biome == 0) biome = 1;
+
+      SDL_Color c[TILE_LAYERS];
+      c[TILE_BIOME] = WorldMap::biomeColor(biome, terrain.riverMap[cell]);
+      c[TILE_DEPTH] = depthColor(depth);
+      c[TILE_AVGTEMP] = ramp(bilinear(climate.AvgTempMap, ci, cj), { 0x2d, 0x56, 0x85, 255 }, { 0xd0, 0x40, 0x20, 255 });
+      c[TILE_AVGHUMIDITY] = ramp(bilinear(climate.AvgHumidityMap, ci, cj), { 0xea, 0xdf, 0x9e, 255 }, { 0x20, 0x40, 0xa0, 255 });
+      c[TILE_AVGRAIN] = ramp(10*bilinear(climate.AvgRainMap, ci, cj), { 0xff, 0xff, 0xff, 255 }, { 0x10, 0x2a, 0x50, 255 });
+      for(int layer = 0; layer<TILE_LAYERS; layer++){
+        Uint8* p = &pixels[layer][(py*tileSize+px)*4];
+        p[0] = c[layer].r; p[1] = c[layer].g; p[2] = c[layer].b; p[3] = c[layer].a;
+      }
+    }
+  }
+}
+
+bool TileExporter::run(std::ostream& out){
+  const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+  //Pixel Hashes of the last Export
+  std::map<std::string, uint64_t> manifest;
+  const std::string manifestPath = dir+"/manifest.txt";
+  {
+    std::ifstream in(manifestPath.c_str());
+    std::string name;
+    uint64_t hash;
+    while(in >> name >> std::hex >> hash) manifest[name] = hash;
+  }
+
+  //Directories first, so the Workers only write Files
+  std::vector<Tile> tiles;
+  mkdir(dir.c_str(), 0755);
+  for(int layer = 0; layer<TILE_LAYERS; layer++){
+    const std::string layerDir = dir+"/"+tileLayerNames[layer];
+    mkdir(layerDir.c_str(), 0755);
+    for(int z = 0; z<levels(); z++){
+      const std::string zoomDir = layerDir+"/"+std::to_string(z);
+      mkdir(zoomDir.c_str(), 0755);
+      for(int x = 0; x<(1<<z); x++) mkdir((zoomDir+"/"+std::to_string(x)).c_str(), 0755);
+    }
+  }
+  for(int z = 0; z<levels(); z++)
+    for(int x = 0; x<(1<<z); x++)
+      for(int y = 0; y<(1<<z); y++) tiles.push_back({ z, x, y });
+
+  //Detail Tiles cost far more than coarse ones, so Workers take the next Tile as they finish
+  std::vector<uint64_t> hashes(tiles.size()*TILE_LAYERS);
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> written(0);
+  std::atomic<size_t> failed(0);
+  workers().run([&](int){
+    module::Perlin perlin = {};
+    Terrain::depthNoise(perlin);
+    std::vector<Uint8> pixels[TILE_LAYERS];
+    for(int layer = 0; layer<TILE_LAYERS; layer++) pixels[layer].resize(tileSize*tileSize*4);
+    for(size_t n = next++; n<tiles.size(); n = next++){
+      render(tiles[n], perlin, pixels);
+      for(int layer = 0; layer<TILE_LAYERS; layer++){
+        const std::string name = path(layer, tiles[n]);
+        const uint64_t hash = fnv1a(pixels[layer].data(), pixels[layer].size());
+        hashes[n*TILE_LAYERS+layer] = hash;
+        std::map<std::string, uint64_t>::const_iterator old = manifest.find(name);
+        struct stat info;
+        if(old != manifest.end() && old->second == hash && stat((dir+"/"+name).c_str(), &info) == 0) continue;
+
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(pixels[layer].data(), tileSize, tileSize, 32, tileSize*4, SDL_PIXELFORMAT_RGBA32);
+        if(surface == NULL || IMG_SavePNG(surface, (dir+"/"+name).c_str()) != 0){
+          failed++;
+          hashes[n*TILE_LAYERS+layer] = 0;
+        }
+        else written++;
+        if(surface != NULL) SDL_FreeSurface(surface);
+      }
+    }
+  });
+
+  std::ofstream file(manifestPath.c_str());
+  for(size_t n = 0; n<tiles.size(); n++)
+    for(int layer = 0; layer<TILE_LAYERS; layer++)
+      file << path(layer, tiles[n]) << " " << std::hex << hashes[n*TILE_LAYERS+layer] << std::dec << "\n";
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+  const size_t total = tiles.size()*TILE_LAYERS;
+  out << "Tiles: " << levels() << " levels, " << total << " tiles, " << written << " written, "
+      << total-written-failed << " unchanged, " << failed << " failed in " << seconds << " s" << std::endl;
+  return failed == 0 && (bool)file;
+}
@@ -0,0 +1,185 @@
+//Chrome Trace-Event Recording
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <stdint.h>
+#include <stdio.h>
+
+//Fields are relaxed Atomics so write() may read a Slot the owning Thread is filling,
+//seq is the Event's Index+1 once the Slot holds it and 0 while it is being written
+struct TraceEvent {
+  std::atomic<const char*> name{nullptr};
+  std::atomic<char> phase{0}; //'B'egin or 'E'nd
+  std::atomic<uint64_t> ns{0};
+  std::atomic<uint64_t> seq{0};
+};
+
+//Single Producer Ring, owned by one Thread
+class TraceBuffer {
+  public:
+  static const uint64_t capacity = 1<<16;
+  TraceEvent events[capacity];
+  //Total Events ever written, the Ring keeps the last capacity
+  std::atomic<uint64_t> head{0};
+  int tid = 0;
+  std::string name;
+
+  void push(const char* name, char phase, uint64_t ns);
+  //Copies Event i, false if it was overwritten or is still being written
+  bool read(uint64_t i, const char*& name, char& phase, uint64_t& ns) const;
+};
+
+class Tracer {
+  public:
+  ~Tracer();
+
+  //The only Check on the Hot Path when Tracing is off, read by every Thread, flipped by the main Thread
+  std::atomic<bool> enabled{false};
+  std::string path = "territory_trace.json";
+
+  //Events recorded before the last start() are left out of write()
+  void start(const std::string& path);
+  //Stops recording, the Events so far stay for write()
+  void stop();
+  bool active() const { return enabled.load(std::memory_order_relaxed); }
+  void record(const char* name, char phase);
+  //Names the calling Thread, its Buffer is only created once it records
+  void nameThread(const std::string& name);
+  bool write() const;
+
+  private:
+  TraceBuffer* local();
+  uint64_t now() const;
+  std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+  //Time of the last start()
+  std::atomic<uint64_t> since{0};
+  mutable std::mutex registry;
+  std::vector<TraceBuffer*> buffers;
+};
+
+extern Tracer tracer;
+
+//Begin/End Pair around the Lifetime of the Scope
+class TraceScope {
+  public:
+  TraceScope(const char* name) : name(name), active(tracer.active()) {
+    if(active) tracer.record(name, 'B');
+  }
+  ~TraceScope(){
+    if(active) tracer.record(name, 'E');
+  }
+
+  private:
+  const char* name;
+  bool active;
+};
+
+void TraceBuffer::push(const char* name, char phase, uint64_t ns){
+  const uint64_t h = head.load(std::memory_order_relaxed);
+  TraceEvent& e = events[h&(capacity-1)];
+  e.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  e.name.store(name, std::memory_order_relaxed);
+  e.phase.store(phase, std::memory_order_relaxed);
+  e.ns.store(ns, std::memory_order_relaxed);
+  e.seq.store(h+1, std::memory_order_release);
+  head.store(h+1, std::memory_order_release);
+}
+
+bool TraceBuffer::read(uint64_t i, const char*& nameOut, char& phaseOut, uint64_t& nsOut) const {
+  const TraceEvent& e = events[i&(capacity-1)];
+  if(e.seq.load(std::memory_order_acquire) != i+1) return false;
+  nameOut = e.name.load(std::memory_order_relaxed);
+  phaseOut = e.phase.load(std::memory_order_relaxed);
+  nsOut = e.ns.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return e.seq.load(std::memory_order_relaxed) == i+1;
+}
+
+Tracer::~Tracer(){
+  for(size_t i = 0; i<buffers.size(); i++)
+    delete buffers[i];
+}
+
+void Tracer::start(const std::string& pathIn){
+  if(!pathIn.empty()) path = pathIn;
+  since.store(now(), std::memory_order_relaxed);
+  enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::stop(){
+  enabled.store(false, std::memory_order_relaxed);
+}
+
+//Name given to the Thread before its Buffer exists
+static thread_local std::string traceThreadName;
+static thread_local TraceBuffer* traceThreadBuffer = nullptr;
+
+TraceBuffer* Tracer::local(){
+  if(traceThreadBuffer == nullptr){
+    traceThreadBuffer = new TraceBuffer();
+    std::lock_guard<std::mutex> lock(registry);
+    traceThreadBuffer->tid = (int)buffers.size();
+    traceThreadBuffer->name = traceThreadName.empty() ? "thread "+std::to_string(traceThreadBuffer->tid) : traceThreadName;
+    buffers.push_back(traceThreadBuffer);
+  }
+  return traceThreadBuffer;
+}
+
+uint64_t Tracer::now() const {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-origin).count();
+}
+
+void Tracer::record(const char* name, char phase){
+  local()->push(name, phase, now());
+}
+
+void Tracer::nameThread(const std::string& name){
+  traceThreadName = name;
+  if(traceThreadBuffer == nullptr) return;
+  std::lock_guard<std::mutex> lock(registry);
+  traceThreadBuffer->name = name;
+}
+
+bool Tracer::write() const {
+  std::ofstream file(path);
+  if(!file.is_open()) return false;
+
+  std::lock_guard<std::mutex> lock(registry);
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  for(size_t b = 0; b<buffers.size(); b++){
+    const TraceBuffer* buffer = buffers[b];
+    if(!first) file << ",\n";
+    first = false;
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+         << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+
+    //Events still in the Ring from the last start() on, Slots a late Writer is overwriting are skipped
+    const uint64_t from = since.load(std::memory_order_relaxed);
+    const uint64_t end = buffer->head.load(std::memory_order_acquire);
+    const uint64_t begin = (end > TraceBuffer::capacity) ? end-TraceBuffer::capacity : 0;
+    int depth = 0;
+    for(uint64_t i = begin; i<end; i++){
+      const char* name;
+      char phase;
+      uint64_t ns;
+      if(!buffer->read(i, name, phase, ns) || ns < from) continue;
+      //Ends whose Begin fell out of the Ring are dropped
+      if(phase == 'E'){
+        if(depth == 0) continue;
+        depth--;
+      }
+      else depth++;
+      char ts[32];
+      snprintf(ts, sizeof(ts), "%.3f", ns/1000.0);
+      file << ",\n{\"name\":\"" << name << "\",\"ph\":\"" << phase << "\",\"ts\":" << ts
+           << ",\"pid\":1,\"tid\":" << buffer->tid << "}";
+    }
+  }
+  file << "\n]}\n";
+  return true;
+}
@@ -4,11 +4,17 @@
 #include "worldgen.h"
 #include "game.h"
 #include <time.h>
+#include <vector>
+#include <map>
+#include "text.h"
+#include "assets.h"
+#include "prefetch.h"
 
 //Texture wrapper class
 class View {
  public:
    View(size_t gridSize);
+   ~View();
    size_t gridSize = gridSizeDefault;
    //For FPS Counter
    int ticks= 0;
@@ -21,27 +27,66 @@ class View {
 
    //Drawing Functions
 	 bool loadTilemap(SDL_Renderer* gRenderer);
-   void writeText(SDL_Renderer* gRenderer);
+   GlyphAtlas* font(SDL_Renderer* gRenderer, int size);
+   void writeText(SDL_Renderer* gRenderer, const char* text, int x, int y, int size = 16);
+   void writeStatic(SDL_Renderer* gRenderer, const std::string& text, int x, int y, int size = 16);
+   void flushText(SDL_Renderer* gRenderer);
    void calcFPS();
+   void renderProfiler(SDL_Renderer* gRenderer);
+   void renderStatus(SDL_Renderer* gRenderer, int day, const std::string& overlay, float speed);
 
    //Overlay Rendering
    void renderMap(const World* territory, SDL_Renderer* gRenderer, int xview, int yview);
    void renderLocal(World* territory, SDL_Renderer* gRenderer, const Player* player);
-   void renderVegetation(const World* territory, SDL_Renderer* gRenderer, const Player* player, int i, int j, int tileScale);
+   void renderVegetation(const World* territory, int tileScale);
    void renderPlayer(const World* territory, SDL_Renderer* gRenderer, const Player* player);
 
    //View altering Functions
    void switchView();
    void rotateView();
+   //Drops the Helpers bound to the World, call before deleting it
+   void detach();
 
  private:
-   SDL_Texture* mTexture = NULL;
-   SDL_Texture* treeTexture = NULL;
-   TTF_Font * gFont = NULL;
+   //Every Image and the HUD Font share one Texture
+   AssetManager assets;
+   AssetHandle tilesAsset = -1;
+   AssetHandle treeAsset = -1;
+   AssetHandle trunkAsset = -1;
+   AssetHandle grassAsset = -1;
+   const int hudFontSize = 16;
+   //Glyph Atlas per Font Size
+   std::map<int, GlyphAtlas*> fonts;
+
+   //Climate at the Local Tiles
+   ClimateQuery* query = NULL;
+   std::vector<float> localRain;
+   //Local Areas ahead of the Player
+   LocalPrefetcher* prefetch = NULL;
+
+   //Tiles and Trees of the Local View, drawn from the Atlas in one Call.
+   //The Rain Tint is the Vertex Color, so the Texture State never changes between Tiles.
+   std::vector<SDL_Vertex> localVertices;
+   std::vector<int> localIndices;
+   void batchQuad(const SDL_Rect& source, const SDL_Rect& dest, SDL_Color color);
+   void flushBatch(SDL_Renderer* gRenderer);
 };
 
 View::View(size_t gridSizeIn) : gridSize(gridSizeIn) {}
 
+View::~View(){
+  for(std::map<int, GlyphAtlas*>::iterator it = fonts.begin(); it != fonts.end(); ++it)
+    delete it->second;
+  detach();
+}
+
+void View::detach(){
+  delete prefetch;
+  prefetch = NULL;
+  delete query;
+  query = NULL;
+}
+
 void View::switchView(){
   viewMode = (viewMode+1)%3;
 }
@@ -51,37 +96,120 @@ void View::rotateView(){
 }
 
 void View::calcFPS(){
-  FPS = 1000/(SDL_GetTicks()-ticks);
+  //Median Frame Time of the Rolling Window, Robust to Frames in the same Tick
+  double frameMS = profiler.percentile(PROFILE_FRAME, 0.5);
+  FPS = (frameMS > 0) ? (int)(1000/frameMS+0.5) : 0;
   ticks = SDL_GetTicks();
-  std::cout<< "FPS: "<<FPS<<std::endl;
 }
 
-void View::writeText(SDL_Renderer* gRenderer){
-  //Load the Font in the desired Size
-  gFont = TTF_OpenFont("font.ttf", 50);
-  //Set textcolor
+GlyphAtlas* View::font(SDL_Renderer* gRenderer, int size){
+  //Built once per Size, a failed Build stays empty and draws nothing
+  std::map<int, GlyphAtlas*>::iterator it = fonts.find(size);
+  if(it != fonts.end()) return it->second;
+  GlyphAtlas* atlas = new GlyphAtlas();
+  if(!atlas->build(gRenderer, "font.ttf", size)){
+    std::cout<<"Couldn't load font.ttf"<<std::endl;
+  }
+  fonts[size] = atlas;
+  return atlas;
+}
+
+void View::writeText(SDL_Renderer* gRenderer, const char* text, int x, int y, int size){
   SDL_Color color = { 255, 255, 255 , 255 };
-  //Render the Text
-  SDL_Surface * surface = TTF_RenderText_Solid(gFont, "100", color);
-  SDL_Texture * texture = SDL_CreateTextureFromSurface(gRenderer, surface);
+  font(gRenderer, size)->add(text, x, y, color);
+}
+
+void View::writeStatic(SDL_Renderer* gRenderer, const std::string& text, int x, int y, int size){
+  SDL_Color color = { 255, 255, 255 , 255 };
+  font(gRenderer, size)->addStatic(text, x, y, color);
+}
+
+void View::flushText(SDL_Renderer* gRenderer){
+  for(std::map<int, GlyphAtlas*>::iterator it = fonts.begin(); it != fonts.end(); ++it)
+    it->second->flush(gRenderer);
+}
+
+void View::renderProfiler(SDL_Renderer* gRenderer){
+  if(!profiler.showHUD) return;
+  calcFPS();
+
+  //Background Panel
+  const int lineHeight = 18;
   SDL_Rect rect;
-    //Replace this with logic based on territory->terrain.surfaceMap[i][j];
-    rect.x=0;
-    rect.y=0;
-    SDL_QueryTexture(texture,NULL,NULL,&rect.w,&rect.h);
-  SDL_RenderCopy(gRenderer, texture, NULL, &rect);
+  rect.x=0;
+  rect.y=0;
+  rect.w=470;
+  rect.h=(PROFILE_STAGES+2)*lineHeight;
+  SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0x00, 180);
+  SDL_RenderFillRect(gRenderer, &rect);
+
+  //One Line per Stage that has been hit, in Milliseconds
+  static const std::string header = "stage             p50 / p95 / p99 ms";
+  char line[64];
+  snprintf(line, sizeof(line), "FPS %d", FPS);
+  writeText(gRenderer, line, 5, 2);
+  writeStatic(gRenderer, header, 90, 2);
+  int y = 2+lineHeight;
+  for(int i = 0; i<PROFILE_STAGES; i++){
+    if(profiler.count(i) == 0) continue;
+    snprintf(line, sizeof(line), "%8.3f %8.3f %8.3f",
+      profiler.percentile(i, 0.5), profiler.percentile(i, 0.95), profiler.percentile(i, 0.99));
+    writeStatic(gRenderer, profileStrings[i], 5, y);
+    writeText(gRenderer, line, 180, y);
+    y += lineHeight;
+  }
+  flushText(gRenderer);
+}
+
+void View::renderStatus(SDL_Renderer* gRenderer, int day, const std::string& overlay, float speed){
+  const int lineHeight = 18;
+  SDL_Rect rect;
+  rect.x=0;
+  rect.y=SCREEN_HEIGHT-lineHeight-4;
+  rect.w=360;
+  rect.h=lineHeight+4;
+  SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0x00, 150);
+  SDL_RenderFillRect(gRenderer, &rect);
+
+  char line[64];
+  snprintf(line, sizeof(line), "Day %d", day);
+  writeText(gRenderer, line, 5, rect.y+2);
+  writeStatic(gRenderer, overlay, 100, rect.y+2);
+  snprintf(line, sizeof(line), "%.2f d/s", speed);
+  writeText(gRenderer, line, 270, rect.y+2);
+  flushText(gRenderer);
 }
 
 bool View::loadTilemap(SDL_Renderer* gRenderer){
-  mTexture = IMG_LoadTexture( gRenderer, "tiles.png" );
-  treeTexture = IMG_LoadTexture( gRenderer, "trunk2.png" );
-  if(mTexture != NULL){
+  //Decode everything once, Rendering never touches the Filesystem
+  tilesAsset = assets.load("tiles.png");
+  treeAsset = assets.load("trunk2.png");
+  trunkAsset = assets.load("trunk.png");
+  grassAsset = assets.load("grass.png");
+
+  //The HUD Font is packed alongside
+  GlyphAtlas* hud = new GlyphAtlas();
+  AssetHandle fontAsset = assets.add("font.ttf", hud->render("font.ttf", hudFontSize));
+
+  if(!assets.pack(gRenderer)){
+    delete hud;
+    return 0;
+  }
+  if(fontAsset >= 0){
+    hud->attach(assets.texture(), assets.rect(fontAsset), assets.atlasWidth(), assets.atlasHeight());
+    fonts[hudFontSize] = hud;
+  }
+  else delete hud;
+
+  if(tilesAsset >= 0 && treeAsset >= 0 && trunkAsset >= 0){
     return 1;
   }
   else return 0;
 }
 
 void View::renderMap(const World* territory, SDL_Renderer* gRenderer, int /*xview*/, int /*yview*/) {
+  ScopedTimer timer(PROFILE_RENDERMAP);
+  if(!assets.valid(tilesAsset)) return;
 	//Set rendering space and render to screen
   //Isometric Tiling Logic Based on Height and Surface Map
   int tileScale = 5;
@@ -90,12 +218,8 @@ void View::renderMap(const World* territory, SDL_Renderer* gRenderer, int /*xvie
       //For the Depth
       for(int k =0; k<40; k++){
         //Take Sourcequad from Territory Surface Tile
-        SDL_Rect sourceQuad;
-          //Replace this with logic based on territory->terrain.surfaceMap[i][j];
-          sourceQuad.x=0;
-          sourceQuad.y=territory->terrain.biomeMap[i*gridSize+j]*11;
-          sourceQuad.w=11;
-          sourceQuad.h=11;
+        //Replace this with logic based on territory->terrain.surfaceMap[i][j];
+        SDL_Rect sourceQuad = assets.source(tilesAsset, 0, territory->terrain.biomeMap[i*gridSize+j]*11, 11, 11);
         //Take Renderquad from current i and j numbers
         //Height is in Intervals of 100
         if((int)territory->terrain.depthMap[i*gridSize+j]/100>=k){
@@ -106,7 +230,7 @@ void View::renderMap(const World* territory, SDL_Renderer* gRenderer, int /*xvie
             renderQuad.h=tileScale*11;
           //Render
           if(renderQuad.x > -10 && renderQuad.x < SCREEN_WIDTH && renderQuad.y < SCREEN_HEIGHT && renderQuad.y > -10){
-            SDL_RenderCopy( gRenderer, mTexture, &sourceQuad, &renderQuad);
+            SDL_RenderCopy( gRenderer, assets.texture(), &sourceQuad, &renderQuad);
           }
         }
       }
@@ -123,13 +247,10 @@ void View::renderMap(const World* territory, SDL_Renderer* gRenderer, int /*xvie
 }
 
 void View::renderPlayer(const World* territory, SDL_Renderer* gRenderer, const Player* /*player*/){
-  treeTexture = IMG_LoadTexture( gRenderer, "trunk.png" );
-  SDL_Rect sourceQuad;
+  ScopedTimer timer(PROFILE_RENDERPLAYER);
+  if(!assets.valid(trunkAsset)) return;
+  SDL_Rect sourceQuad = assets.source(trunkAsset, 0, 0, 11, 22);
   int tileScale = 5;
-    sourceQuad.x=0;
-    sourceQuad.y=0;
-    sourceQuad.w=11;
-    sourceQuad.h=22;
 
     SDL_Rect renderQuad;
     int i = localGrid/2-1;
@@ -139,17 +260,40 @@ void View::renderPlayer(const World* territory, SDL_Renderer* gRenderer, const P
     renderQuad.h=tileScale*22;
     renderQuad.x=territory->terrain.worldWidth/2+tileScale*5*(-1);
     renderQuad.y=territory->terrain.worldHeight/2-tileScale*5-tileScale*2*11-((int)territory->terrain.localMap[localCell]-(int)territory->terrain.localMap[localCell])*5*tileScale;
-    SDL_RenderCopy( gRenderer, treeTexture, &sourceQuad, &renderQuad);
+    SDL_RenderCopy( gRenderer, assets.texture(), &sourceQuad, &renderQuad);
 }
 
-void View::renderVegetation(const World* territory, SDL_Renderer* gRenderer, const Player* player, int i, int j, int tileScale){
-  //If there is a tree present at given location
-  if(territory->vegetation.getTree(territory, player, i, j)){
-    SDL_Rect sourceQuad;
-      sourceQuad.x=0;
-      sourceQuad.y=0;
-      sourceQuad.w=11;
-      sourceQuad.h=22;
+void View::batchQuad(const SDL_Rect& source, const SDL_Rect& dest, SDL_Color color){
+  //Quad Corners: Top Left, Top Right, Bottom Right, Bottom Left
+  const float u0 = (float)source.x/assets.atlasWidth(), u1 = (float)(source.x+source.w)/assets.atlasWidth();
+  const float v0 = (float)source.y/assets.atlasHeight(), v1 = (float)(source.y+source.h)/assets.atlasHeight();
+  SDL_Vertex v;
+  v.color = color;
+  v.position.x = dest.x;        v.position.y = dest.y;        v.tex_coord.x = u0; v.tex_coord.y = v0; localVertices.push_back(v);
+  v.position.x = dest.x+dest.w; v.position.y = dest.y;        v.tex_coord.x = u1; v.tex_coord.y = v0; localVertices.push_back(v);
+  v.position.x = dest.x+dest.w; v.position.y = dest.y+dest.h; v.tex_coord.x = u1; v.tex_coord.y = v1; localVertices.push_back(v);
+  v.position.x = dest.x;        v.position.y = dest.y+dest.h; v.tex_coord.x = u0; v.tex_coord.y = v1; localVertices.push_back(v);
+}
+
+void View::flushBatch(SDL_Renderer* gRenderer){
+  if(localVertices.empty()) return;
+  //Two Triangles per Quad, the Index Pattern only ever grows
+  const size_t quads = localVertices.size()/4;
+  for(size_t q = localIndices.size()/6; q<quads; q++){
+    const int base = (int)q*4;
+    const int quad[6] = { base, base+1, base+2, base, base+2, base+3 };
+    localIndices.insert(localIndices.end(), quad, quad+6);
+  }
+  SDL_RenderGeometry(gRenderer, assets.texture(), localVertices.data(), (int)localVertices.size(), localIndices.data(), (int)quads*6);
+  localVertices.clear();
+}
+
+void View::renderVegetation(const World* territory, int tileScale){
+  ScopedTimer timer(PROFILE_RENDERVEGETATION);
+  if(!assets.valid(treeAsset)) return;
+  //The Caller checked there is a Tree at the given location
+  {
+    SDL_Rect sourceQuad = assets.source(treeAsset, 0, 0, 11, 22);
 
       int hs = localGrid/2;
       int i = hs-1;
@@ -161,16 +305,27 @@ void View::renderVegetation(const World* territory, SDL_Renderer* gRenderer, con
       renderQuad.h=tileScale*22;
       renderQuad.x=territory->terrain.worldWidth/2+tileScale*5*(-1+j-i);
       renderQuad.y=territory->terrain.worldHeight/2-tileScale*5-tileScale*17+3*tileScale*((j-hs)+(i-hs))-((int)territory->terrain.localMap[localCell]-(int)territory->terrain.localMap[localCell])*5*tileScale;
-      SDL_RenderCopy( gRenderer, treeTexture, &sourceQuad, &renderQuad);
+      //Trees share the Atlas but are not tinted
+      const SDL_Color white = {255, 255, 255, 255};
+      batchQuad(sourceQuad, renderQuad, white);
   }
 }
 
 void View::renderLocal(World* territory, SDL_Renderer* gRenderer, const Player* player){
+  ScopedTimer timer(PROFILE_RENDERLOCAL);
   //Set rendering space and render to screen
   //Generate the Local Area
   //Isometric Tiling Logic Based on Height and Surface Map
   int tileScale = 6;
-  territory->terrain.genLocal(territory->seed, player);
+  if(prefetch == NULL) prefetch = new LocalPrefetcher(territory);
+  const LocalArea& area = prefetch->area(player->xTotal, player->yTotal);
+  std::copy(area.depth.begin(), area.depth.end(), territory->terrain.localMap);
+
+  //Sample the Rain for the whole Local Area at once
+  if(query == NULL) query = new ClimateQuery(territory);
+  localRain.resize(localGrid*localGrid);
+  query->sampleLocal(LAYER_RAIN, player->xTotal, player->yTotal, localGrid, localRain.data());
+  if(!assets.valid(tilesAsset)) return;
 
   int hs = localGrid/2;
   int lc = hs-1;
@@ -181,12 +336,9 @@ void View::renderLocal(World* territory, SDL_Renderer* gRenderer, const Player*
         const size_t localCell = i*localGrid+j;
 
         //Take Sourcequad from Territory Surface Tile
-        SDL_Rect sourceQuad;
-          //Replace this with logic based on territory->terrain.surfaceMap[localCell];
-          sourceQuad.x=(int)(territory->terrain.localMap[localCell]*4)%3*11;
-          sourceQuad.y=territory->terrain.biomeMap[((player->xTotal+i-hs)/territory->terrain.worldWidth)*gridSize+((player->yTotal+j-hs)/territory->terrain.worldHeight)]*11;
-          sourceQuad.w=11;
-          sourceQuad.h=11;
+        //Replace this with logic based on territory->terrain.surfaceMap[localCell];
+        SDL_Rect sourceQuad = assets.source(tilesAsset, (int)(territory->terrain.localMap[localCell]*4)%3*11,
+          query->biome(player->xTotal+i-hs, player->yTotal+j-hs)*11, 11, 11);
         //Take Renderquad from current i and j numbers
         //Height is in Intervals of 100
           SDL_Rect renderQuad;
@@ -194,10 +346,14 @@ void View::renderLocal(World* territory, SDL_Renderer* gRenderer, const Player*
           renderQuad.h=tileScale*11;
           renderQuad.x=territory->terrain.worldWidth/2+tileScale*5*((j-hs)-(i-hs)-1);
           renderQuad.y=territory->terrain.worldHeight/2-tileScale*5+3*tileScale*((j-hs)+(i-hs))-((int)territory->terrain.localMap[localCell]-(int)territory->terrain.localMap[lc*uc])*5*tileScale;
+          //Rain darkens the Ground
+          const Uint8 wet = (Uint8)(90*localRain[localCell]);
+          const SDL_Color tint = {(Uint8)(255-wet), (Uint8)(255-wet), (Uint8)(255-wet/3), 255};
           //Render
           //Render the Vegetation on the Map
-          SDL_RenderCopy( gRenderer, mTexture, &sourceQuad, &renderQuad);
-          renderVegetation(territory, gRenderer, player, i, j, tileScale);
+          batchQuad(sourceQuad, renderQuad, tint);
+          if(area.tree[localCell]) renderVegetation(territory, tileScale);
     }
   }
+  flushBatch(gRenderer);
 }
@@ -0,0 +1,98 @@
+//Annual Wind Schedule
+//WindDirection only depends on (day, seed), so it is computed once per Seed and shared
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <memory>
+#include <utility>
+
+struct WindDay {
+  double direction[2];
+  //Upwind Cell Offset used by calcWind, floor(windScale*direction)
+  int offset[2];
+};
+
+class WindSchedule {
+  public:
+  //Shared read-only Schedule for a Seed and Cell Size, built on first Use
+  static const WindSchedule& get(int seed, int windScale);
+
+  //Days beyond the Table are added a Year at a Time
+  WindDay at(int day) const;
+
+  ~WindSchedule();
+
+  private:
+  WindSchedule(int seed, int windScale);
+
+  static const int daysPerChunk = 365;
+  static const int maxChunks = 64;
+  int seed;
+  int windScale;
+  mutable std::atomic<WindDay*> chunks[maxChunks];
+  mutable std::mutex extend;
+
+  static WindDay compute(const module::Perlin& perlin, int seed, int windScale, int day);
+  WindDay* chunk(int c) const;
+};
+
+WindSchedule::WindSchedule(int seedIn, int windScaleIn) : seed(seedIn), windScale(windScaleIn) {
+  for(int c = 0; c<maxChunks; c++) chunks[c] = nullptr;
+  chunk(0);
+}
+
+WindSchedule::~WindSchedule(){
+  for(int c = 0; c<maxChunks; c++) delete[] chunks[c].load();
+}
+
+const WindSchedule& WindSchedule::get(int seed, int windScale){
+  static std::mutex registryMutex;
+  static std::map<std::pair<int,int>, std::unique_ptr<WindSchedule> > registry;
+  std::lock_guard<std::mutex> lock(registryMutex);
+  std::unique_ptr<WindSchedule>& schedule = registry[std::make_pair(seed, windScale)];
+  if(!schedule) schedule.reset(new WindSchedule(seed, windScale));
+  return *schedule;
+}
+
+WindDay WindSchedule::compute(const module::Perlin& perlin, int seed, int windScale, int day){
+  float timeInterval = (float)day/365;
+
+  //winddirection shifts every Day
+  //One Dimensional Perlin Noise
+  WindDay w;
+  w.direction[0] = (perlin.GetValue(timeInterval, seed, seed));
+  w.direction[1] = (perlin.GetValue(timeInterval, seed+timeInterval, seed));
+  w.offset[0] = (int)floor(windScale*w.direction[0]);
+  w.offset[1] = (int)floor(windScale*w.direction[1]);
+  return w;
+}
+
+WindDay* WindSchedule::chunk(int c) const {
+  WindDay* table = chunks[c].load(std::memory_order_acquire);
+  if(table != nullptr) return table;
+
+  std::lock_guard<std::mutex> lock(extend);
+  table = chunks[c].load(std::memory_order_relaxed);
+  if(table == nullptr){
+    module::Perlin perlin = {};
+    perlin.SetOctaveCount(2);
+    perlin.SetFrequency(4);
+    table = new WindDay[daysPerChunk];
+    for(int d = 0; d<daysPerChunk; d++)
+      table[d] = compute(perlin, seed, windScale, c*daysPerChunk+d);
+    chunks[c].store(table, std::memory_order_release);
+  }
+  return table;
+}
+
+WindDay WindSchedule::at(int day) const {
+  const int c = day/daysPerChunk;
+  if(day >= 0 && c < maxChunks)
+    return chunk(c)[day%daysPerChunk];
+
+  //Past the Table, evaluate directly
+  module::Perlin perlin = {};
+  perlin.SetOctaveCount(2);
+  perlin.SetFrequency(4);
+  return compute(perlin, seed, windScale, day);
+}
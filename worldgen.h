@@ -2,12 +2,24 @@
 #include <libnoise/noise.h>
 #include <iostream>
 #include <stdlib.h>
+#include <math.h>
+#include <vector>
 #include "player.h"
 #include <SDL2/SDL.h>
 #include <time.h>
+#include "profiler.h"
+#include "arena.h"
+#include "parallel.h"
+#include "rng.h"
+#include "kernels.h"
+#include "hydrology.h"
 
 using namespace noise;
 
+#include "wind.h"
+#include "fixedpoint.h"
+#include "climatology.h"
+
 //Screen dimension constants - square
 const int SCREEN_WIDTH = 1000;
 const int SCREEN_HEIGHT = SCREEN_WIDTH;
@@ -20,11 +32,14 @@ class Climate;
 class Terrain;
 class World;
 class Vegetation;
+class ClimateQuery;
 
 class Vegetation{
   public:
   //Calculates wether there is a tree or not
   bool getTree(const World* territory, const Player* player, int i, int j) const;
+  //Same for a global Tile, safe to call from any Thread
+  bool getTree(int seed, int tileX, int tileY) const;
 };
 
 class Terrain{
@@ -33,29 +48,74 @@ class Terrain{
   int worldHeight = 1000;
   int worldWidth = 1000;
   size_t gridSize = gridSizeDefault;
+  //Bumped whenever depthMap or biomeMap change
+  unsigned int revision = 0;
+  //Seed of the last genDepth, keys the Random Streams of later Stages
+  int seed = 0;
 
-  Terrain(size_t gridSize);
-  ~Terrain();
+  //Layers come from arena, or from the Terrain's own Block without one
+  Terrain(size_t gridSize, GridArena* arena = nullptr);
+  static size_t storageBytes(size_t gridSize);
+  GridArena storage;
 
   //Terrain Parameters
   float* depthMap = nullptr;
   void genDepth(int seed);
+  //The Perlin Noise genDepth samples, and its Height at fractional Grid Coordinates before Erosion
+  static void depthNoise(module::Perlin& perlin);
+  float noiseDepth(const module::Perlin& perlin, float i, float j) const;
 
   int* biomeMap = nullptr;
   void genBiome(const Climate& climate);
 
-  //Erodes the Landscape for a number of years
-  void erode(int seed, const Terrain* terrain, int years);
+  //Fields the Climate Kernels derive from the Depth, rebuilt whenever the Depth changes
+  unsigned char* seaMap = nullptr;
+  float* sunMap = nullptr;
+  unsigned char* heightClassMap = nullptr;
+  void calcFields();
+
+  //Tiles whose Depth or Average Climate changed since the last Classification
+  unsigned char* dirtyMap = nullptr;
+  std::vector<size_t> dirtyCells;
+  void markDirty(size_t cell);
+  //Reclassifies only the Dirty Tiles
+  void updateBiome(const Climate& climate);
+  //Tiles whose Biome changed in the last Classification, for Renderers
+  std::vector<size_t> changedCells;
+  //Revision that Classification produced, Renderers can only apply changedCells on top of the one before
+  unsigned int changedRevision = 0;
+  //Classification Results of the Dirty Tiles, filled in Parallel
+  std::vector<int> nextBiome;
+
+  static int depthClass(float depth);
+  static int rainClass(float rain);
+  int classifyBiome(size_t cell, int heightClass, float rain) const;
+
+  //Erodes the Landscape for a number of years, in the Scratch Climates if given
+  void erode(int seed, const Terrain* terrain, int years, Climate* average = nullptr, Climate* simulation = nullptr);
+
+  //Drainage: D8 Direction per Tile (flowNone at Outlets), Rain collected from Upstream, Rivers
+  unsigned char* flowMap = nullptr;
+  float* dischargeMap = nullptr;
+  unsigned char* riverMap = nullptr;
+  std::vector<uint32_t> flowOrder;
+  //Discharge, in Tiles of the default Grid, above which a Tile carries a River
+  const float riverThreshold = 1.0;
+  void calcFlow(const float* rain);
 
   //Local Area (100 Tiles)
   float* localMap = nullptr;
   void genLocal(int seed, const Player* player);
+  //Local Area around (xTotal, yTotal) into out, safe to call from any Thread
+  void genLocal(int seed, int xTotal, int yTotal, float* out) const;
 };
 
 class Climate {
   public:
-  Climate(size_t gridSize);
-  ~Climate();
+  //Layers come from arena, or from the Climate's own Block without one
+  Climate(size_t gridSize, GridArena* arena = nullptr, const char* subsystem = "climate");
+  static size_t storageBytes(size_t gridSize);
+  GridArena storage;
 
   //Curent Climate Maps
   float* TempMap = nullptr;
@@ -64,6 +124,10 @@ class Climate {
   bool* RainMap = nullptr;
   float* WindMap = nullptr;
   double WindDirection[2] = {1,1}; //from 0-1
+  //Upwind Cell of calcWind, derived from WindDirection
+  int windOffset[2] = {0,0};
+  const WindSchedule* windSchedule = nullptr;
+  int windSeed = 0;
 
   //Average Climate Maps
   float* AvgRainMap = nullptr;
@@ -71,8 +135,19 @@ class Climate {
   float* AvgCloudMap = nullptr;
   float* AvgTempMap = nullptr;
   float* AvgHumidityMap = nullptr;
+  //Means per Period of the Year, filled by calcAverage if set
+  Climatology* climatology = nullptr;
+  //Cells whose Rain Class updateAverage shifted, one List per Band of Rows
+  std::vector<std::vector<size_t>> rainShifted;
 
   size_t gridSize = gridSizeDefault;
+  //Bumped whenever the Maps change
+  unsigned int revision = 0;
+
+  //Previous Day of the Map being updated, reused every Step
+  float* oldMap = nullptr;
+  bool* oldCloudMap = nullptr;
+  bool* oldRainMap = nullptr;
 
   void init(int day, int seed, const Terrain* terrain);
   void initTempMap(const Terrain* terrain);
@@ -86,7 +161,24 @@ class Climate {
   void calcDownfallMap();
   void calcWindMap(int day, int seed, const Terrain* terrain);
 
-  void calcAverage(int seed, const Terrain* terrain);
+  //Advance the Climate by one Day
+  void step(int day, int seed, const Terrain* terrain);
+  //Same as stepping through the Days one by one, but several Days advance Band by Band in one Sweep.
+  //If average is set, every Day is added to its running Mean as calcAverage does.
+  void stepBlocked(int firstDay, int days, int seed, const Terrain* terrain, Climate* average);
+  //Grids from this Size on no longer fit the Cache, so calcAverage steps them blocked
+  static const size_t blockedMinGrid = 500;
+  //Days in Flight per Sweep, and the Memory their Maps may take
+  static const int blockedDays = 8;
+  static const size_t blockedBytes = 64<<20;
+  KernelArgs kernelArgs(const Terrain* terrain) const;
+  //Running Average over a Window of Days, marks Tiles whose Biome may change
+  void updateAverage(int window, Terrain* terrain);
+
+  //simulation is a Scratch Climate to run the Year in, allocated for the Call without one
+  void calcAverage(int seed, const Terrain* terrain, Climate* simulation = nullptr);
+  //The same Year simulated in Fixed Point from an initialised Climate, see fixedpoint.h
+  void calcAverageFixed(int seed, const Terrain* terrain, const Climate* start, int days);
 };
 
 class World{
@@ -97,12 +189,78 @@ class World{
   int seed = seedDefault;
   int day = 0;
   size_t gridSize = gridSizeDefault;
+  //One Block for all Grids of the World, sized by storageBytes
+  GridArena arena;
+  static size_t storageBytes(size_t gridSize);
   Climate climate;
   Terrain terrain;
+  //Reused by every Generation instead of fresh Climates per Stage
+  Climate scratchAverage;
+  Climate scratchSimulation;
+  //Seasonal Means of climate, seasonPeriods() per Year
+  Climatology climatology;
   Vegetation vegetation;
 
   void generate();
+  //Live Simulation: Climate, running Averages and evolving Biomes
+  void simulateDay();
   void changePos(SDL_Event e);
+  //FNV-1a over Terrain and Climate, equal for equal Worlds
+  uint64_t checksum() const;
+};
+
+//Generates the same World with one Worker and with the full Pool, true if they match
+bool verifyDeterminism(size_t gridSize, int seed, int days);
+//Generates the World in Float and in Fixed Point and reports how far Biomes and Averages differ
+void comparePrecision(size_t gridSize, int seed, std::ostream& out);
+
+//Layers that can be sampled in World Coordinates
+enum ClimateLayer {
+  LAYER_TEMP,
+  LAYER_HUMIDITY,
+  LAYER_WIND,
+  LAYER_CLOUD,
+  LAYER_RAIN,
+  LAYER_AVGTEMP,
+  LAYER_AVGHUMIDITY,
+  LAYER_AVGWIND,
+  LAYER_AVGCLOUD,
+  LAYER_AVGRAIN,
+  LAYER_DEPTH,
+  LAYER_DISCHARGE,
+  LAYER_RIVER,
+  LAYER_COUNT
+};
+
+//Bilinear Sampling of the Global Maps at World Coordinates (Player::xTotal Units)
+//Keeps the Corners of recently sampled Grid Cells, one Instance per Thread
+class ClimateQuery {
+  public:
+  ClimateQuery(const World* territory);
+
+  float sample(int layer, float x, float y);
+  //Fills size*size Values for the Local Area centered on (xTotal, yTotal), like Terrain::genLocal
+  void sampleLocal(int layer, int xTotal, int yTotal, int size, float* out);
+  //Nearest Cell Biome
+  int biome(float x, float y) const;
+  //Nearest Cell Mean of a Period of the Year, 0 without Climatology
+  float season(SeasonField field, int period, float x, float y) const;
+
+  private:
+  struct Corners {
+    int layer = -1;
+    int i = 0;
+    int j = 0;
+    unsigned int stamp = 0;
+    float v[4];
+  };
+  static const int cacheSize = 64;
+  Corners cache[cacheSize];
+  const World* territory;
+
+  float at(int layer, size_t cell) const;
+  const Corners& corners(int layer, int i, int j);
+  void locate(float x, int cellWidth, int& i, float& t) const;
 };
 
 bool Vegetation::getTree(const World* territory, const Player* player, int i, int j) const {
@@ -127,6 +285,10 @@ bool Vegetation::getTree(const World* territory, const Player* player, int i, in
   (tents, rocks, other locations) and not place vegetation if there is something present
   */
 
+  return getTree(territory->seed, player->xTotal-localGrid/2+i, player->yTotal-localGrid/2+j);
+}
+
+bool Vegetation::getTree(int seed, int tileX, int tileY) const {
   //Perlin Noise Module
   module::Perlin perlin = {};
 
@@ -135,13 +297,14 @@ bool Vegetation::getTree(const World* territory, const Player* player, int i, in
   perlin.SetPersistence(0.8);
 
   //Generate the Height Map with Perlin Noise
-  float x = (float)(player->xTotal-localGrid/2+i)/100000;
-  float y = (float)(player->yTotal-localGrid/2+j)/100000;
+  float x = (float)tileX/100000;
+  float y = (float)tileY/100000;
 
   //This is not an efficient tree generation method
   //But a reasonable distribution for a grassland area
-  srand(x+y);
-  int tree = ((int)(1/(perlin.GetValue(x, y, territory->seed+1)+1))*rand()%5)/4;
+  //One Draw per global Tile, so a Tile keeps its Tree wherever the View is
+  const uint32_t draw = cellRandom(seed, RANDOM_VEGETATION, ((uint64_t)(uint32_t)tileX<<32)|(uint32_t)tileY);
+  int tree = (((int)(1/(perlin.GetValue(x, y, seed+1)+1))%5)*(int)(draw%5)%5)/4;
 
   return tree;
 }
@@ -159,98 +322,336 @@ void World::changePos(SDL_Event e){
     }
 }
 
-World::World(size_t gridSize, int seedIn) : seed(seedIn), climate(gridSize), terrain(gridSize) { }
+World::World(size_t gridSizeIn, int seedIn) : seed(seedIn), gridSize(gridSizeIn), arena(storageBytes(gridSizeIn)),
+  climate(gridSizeIn, &arena), terrain(gridSizeIn, &arena),
+  scratchAverage(gridSizeIn, &arena, "scratch climate"), scratchSimulation(gridSizeIn, &arena, "scratch climate"),
+  climatology(gridSizeIn, seasonPeriods()) {
+  climate.climatology = &climatology;
+}
+
+size_t World::storageBytes(size_t gridSize){
+  return 3*Climate::storageBytes(gridSize)+Terrain::storageBytes(gridSize);
+}
 
 void World::generate(){
+  TraceScope trace("generate");
   //Geography
   //Generate and save a heightmap for all Blocks, all Regions
   terrain.genDepth(seed);
 
   //Erode the Landscape based on iterative average climate
-  terrain.erode(seed, &terrain, 1);
+  terrain.erode(seed, &terrain, 1, &scratchAverage, &scratchSimulation);
 
   //Calculate the climate system of the eroded landscape
   climate.init(day, seed, &terrain);
-  climate.calcAverage(seed, &terrain);
+  climate.calcAverage(seed, &terrain, &scratchSimulation);
+
+  //Rivers of the final Landscape
+  terrain.calcFlow(climate.AvgRainMap);
 
   //Generate the Surface Composition
   terrain.genBiome(climate);
 }
 
+void World::simulateDay(){
+  day += 1;
+  climate.step(day, seed, &terrain);
+  climate.updateAverage(365, &terrain);
+  terrain.updateBiome(climate);
+}
+
+uint64_t fnv1a(const void* data, size_t bytes, uint64_t hash = 14695981039346656037ull){
+  const unsigned char* p = (const unsigned char*)data;
+  for(size_t n = 0; n<bytes; n++){
+    hash ^= p[n];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t World::checksum() const {
+  const size_t gridSizeSq = terrain.gridSize*terrain.gridSize;
+  uint64_t hash = fnv1a(terrain.depthMap, gridSizeSq*sizeof(float));
+  hash = fnv1a(terrain.biomeMap, gridSizeSq*sizeof(int), hash);
+  const float* maps[] = { climate.TempMap, climate.HumidityMap, climate.WindMap,
+    climate.AvgRainMap, climate.AvgWindMap, climate.AvgCloudMap, climate.AvgTempMap, climate.AvgHumidityMap };
+  for(size_t m = 0; m<sizeof(maps)/sizeof(maps[0]); m++)
+    hash = fnv1a(maps[m], gridSizeSq*sizeof(float), hash);
+  hash = fnv1a(climate.CloudMap, gridSizeSq*sizeof(bool), hash);
+  hash = fnv1a(climate.RainMap, gridSizeSq*sizeof(bool), hash);
+  return hash;
+}
+
+bool verifyDeterminism(size_t gridSize, int seed, int days){
+  const int threads = workers().size();
+  uint64_t hash[2];
+  for(int pass = 0; pass<2; pass++){
+    setWorkerCount(pass == 0 ? 1 : threads);
+    World world(gridSize, seed);
+    world.generate();
+    for(int d = 0; d<days; d++) world.simulateDay();
+    hash[pass] = world.checksum();
+    std::cout<<"Workers "<<workers().size()<<": "<<std::hex<<hash[pass]<<std::dec<<std::endl;
+  }
+  return hash[0] == hash[1];
+}
+
+void comparePrecision(size_t gridSize, int seed, std::ostream& out){
+  const ClimatePrecision previous = climatePrecision();
+  World* worlds[2];
+  double ms[2];
+  for(int pass = 0; pass<2; pass++){
+    climatePrecision() = pass == 0 ? PRECISION_FLOAT : PRECISION_FIXED16;
+    const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    worlds[pass] = new World(gridSize, seed);
+    worlds[pass]->generate();
+    ms[pass] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-begin).count();
+  }
+  climatePrecision() = previous;
+
+  const size_t gridSizeSq = gridSize*gridSize;
+  const Terrain& a = worlds[0]->terrain;
+  const Terrain& b = worlds[1]->terrain;
+  //Confusion of the Biomes, Float Rows against Fixed Columns
+  const int biomes = 11;
+  std::vector<size_t> confusion(biomes*biomes, 0);
+  size_t same = 0;
+  for(size_t cell = 0; cell<gridSizeSq; cell++){
+    if(a.biomeMap[cell] == b.biomeMap[cell]) same++;
+    if(a.biomeMap[cell] >= 0 && a.biomeMap[cell] < biomes && b.biomeMap[cell] >= 0 && b.biomeMap[cell] < biomes)
+      confusion[a.biomeMap[cell]*biomes+b.biomeMap[cell]]++;
+  }
+  out << "Grid " << gridSize << ", seed " << seed << std::endl;
+  out << std::fixed << std::setprecision(1) << "Generation float " << ms[0] << " ms, fixed " << ms[1] << " ms" << std::endl;
+  out << std::setprecision(3) << "Biomes equal: " << 100.0*same/gridSizeSq << "% (" << gridSizeSq-same << " of " << gridSizeSq << " differ)" << std::endl;
+  for(int f = 0; f<biomes; f++){
+    for(int x = 0; x<biomes; x++){
+      if(f != x && confusion[f*biomes+x] > 0) out << "  biome " << f << " -> " << x << ": " << confusion[f*biomes+x] << std::endl;
+    }
+  }
+
+  const char* names[] = { "AvgTemp", "AvgHumidity", "AvgWind", "AvgCloud", "AvgRain", "depth" };
+  const float* maps[2][6] = {
+    { worlds[0]->climate.AvgTempMap, worlds[0]->climate.AvgHumidityMap, worlds[0]->climate.AvgWindMap, worlds[0]->climate.AvgCloudMap, worlds[0]->climate.AvgRainMap, a.depthMap },
+    { worlds[1]->climate.AvgTempMap, worlds[1]->climate.AvgHumidityMap, worlds[1]->climate.AvgWindMap, worlds[1]->climate.AvgCloudMap, worlds[1]->climate.AvgRainMap, b.depthMap }
+  };
+  out << std::setprecision(6);
+  for(int m = 0; m<6; m++){
+    double sum = 0, worst = 0;
+    for(size_t cell = 0; cell<gridSizeSq; cell++){
+      const double d = fabs((double)maps[0][m][cell]-maps[1][m][cell]);
+      sum += d;
+      worst = std::max(worst, d);
+    }
+    out << std::left << std::setw(14) << names[m] << std::right << " mean |diff| " << sum/gridSizeSq << ", max " << worst << std::endl;
+  }
+  delete worlds[0];
+  delete worlds[1];
+}
+
+ClimateQuery::ClimateQuery(const World* territoryIn) : territory(territoryIn) {}
+
+float ClimateQuery::at(int layer, size_t cell) const {
+  const Climate& climate = territory->climate;
+  switch(layer){
+    case LAYER_TEMP: return climate.TempMap[cell];
+    case LAYER_HUMIDITY: return climate.HumidityMap[cell];
+    case LAYER_WIND: return climate.WindMap[cell];
+    case LAYER_CLOUD: return climate.CloudMap[cell];
+    case LAYER_RAIN: return climate.RainMap[cell];
+    case LAYER_AVGTEMP: return climate.AvgTempMap[cell];
+    case LAYER_AVGHUMIDITY: return climate.AvgHumidityMap[cell];
+    case LAYER_AVGWIND: return climate.AvgWindMap[cell];
+    case LAYER_AVGCLOUD: return climate.AvgCloudMap[cell];
+    case LAYER_AVGRAIN: return climate.AvgRainMap[cell];
+    case LAYER_DEPTH: return territory->terrain.depthMap[cell];
+    case LAYER_DISCHARGE: return territory->terrain.dischargeMap[cell];
+    case LAYER_RIVER: return territory->terrain.riverMap[cell];
+  }
+  return 0;
+}
+
+void ClimateQuery::locate(float x, int cellWidth, int& i, float& t) const {
+  //Cell Centers sit at (i+0.5)*cellWidth, clamp to the Grid Edge
+  const int last = (int)territory->terrain.gridSize-2;
+  float fx = x/cellWidth-0.5f;
+  i = (int)floorf(fx);
+  t = fx-i;
+  if(i < 0){ i = 0; t = 0; }
+  else if(i > last){ i = last; t = 1; }
+}
+
+const ClimateQuery::Corners& ClimateQuery::corners(int layer, int i, int j){
+  const unsigned int stamp = territory->climate.revision+territory->terrain.revision;
+  Corners& c = cache[((i*73856093)^(j*19349663)^(layer*83492791))&(cacheSize-1)];
+  if(c.layer == layer && c.i == i && c.j == j && c.stamp == stamp)
+    return c;
+
+  const size_t gridSize = territory->terrain.gridSize;
+  const size_t cell = i*gridSize+j;
+  c.layer = layer;
+  c.i = i;
+  c.j = j;
+  c.stamp = stamp;
+  c.v[0] = at(layer, cell);
+  c.v[1] = at(layer, cell+1);
+  c.v[2] = at(layer, cell+gridSize);
+  c.v[3] = at(layer, cell+gridSize+1);
+  return c;
+}
+
+float ClimateQuery::sample(int layer, float x, float y){
+  int i, j;
+  float t, u;
+  locate(x, territory->terrain.worldWidth, i, t);
+  locate(y, territory->terrain.worldHeight, j, u);
+  const Corners& c = corners(layer, i, j);
+  return (1-t)*((1-u)*c.v[0]+u*c.v[1]) + t*((1-u)*c.v[2]+u*c.v[3]);
+}
+
+void ClimateQuery::sampleLocal(int layer, int xTotal, int yTotal, int size, float* out){
+  //A Local Area spans at most a few Grid Cells, so Corners are only refetched at Cell Borders
+  const Corners* c = nullptr;
+  for(int a = 0; a<size; a++){
+    int i;
+    float t;
+    locate((float)(xTotal-size/2+a), territory->terrain.worldWidth, i, t);
+    for(int b = 0; b<size; b++){
+      int j;
+      float u;
+      locate((float)(yTotal-size/2+b), territory->terrain.worldHeight, j, u);
+      if(c == nullptr || c->i != i || c->j != j)
+        c = &corners(layer, i, j);
+      out[a*size+b] = (1-t)*((1-u)*c->v[0]+u*c->v[1]) + t*((1-u)*c->v[2]+u*c->v[3]);
+    }
+  }
+}
+
+int ClimateQuery::biome(float x, float y) const {
+  const int gridSize = (int)territory->terrain.gridSize;
+  int i = std::min(std::max((int)(x/territory->terrain.worldWidth), 0), gridSize-1);
+  int j = std::min(std::max((int)(y/territory->terrain.worldHeight), 0), gridSize-1);
+  return territory->terrain.biomeMap[i*gridSize+j];
+}
+
+float ClimateQuery::season(SeasonField field, int period, float x, float y) const {
+  const Climatology& climatology = territory->climatology;
+  if(period < 0 || period >= climatology.periods || climatology.revision == 0) return 0;
+  const int gridSize = (int)climatology.gridSize;
+  int i = std::min(std::max((int)(x/territory->terrain.worldWidth), 0), gridSize-1);
+  int j = std::min(std::max((int)(y/territory->terrain.worldHeight), 0), gridSize-1);
+  return climatology.value(field, period, i*gridSize+j);
+}
+
 void Terrain::genBiome(const Climate& climate){
-  /*
-  Determine the Surface Biome:
-  0: Water
-  1: Sandy Beach
-  2: Gravel Beach
-  3: Stone Beach Cliffs
-  4: Wet Plains (Grassland)
-  5: Dry Plains (Shrubland)
-  6: Rocky Hills
-  7: Tempererate Forest
-  8: Boreal Forest
-  9: Mountain Tundra
-  10: Mountain Peak
-
-  Compare the Parameters and decide what kind of ground we have.
-  */
-  for(size_t i = 0; i<gridSize; i++){
-    for(size_t j = 0; j<gridSize; j++){
-      const size_t cell = i*gridSize+j;
-      //0: Water
-      if(depthMap[cell]<=200){
-        biomeMap[cell] = 0;
-      }
-      //1: Sandy Beach
-      else if(depthMap[cell]<=204){
-        biomeMap[cell] = 1;
-      }
-      //2: Gravel Beach
-      else if(depthMap[cell]<210){
-        biomeMap[cell] = 2;
-      }
-      //3: Stony Beach Cliffs
-      else if(depthMap[cell]<=220){
-        biomeMap[cell] = 3;
-      }
-      //4: Wet Plains (Grassland)
-      //5: Dry Plains (Shrubland)
-      else if(depthMap[cell]<=600){
-        if(climate.AvgRainMap[cell]>=0.02){
-          biomeMap[cell] = 4;
-        }
-        else{
-          biomeMap[cell] = 5;
-        }
-      }
-      //6: Rocky Hills
-      //7: Temperate Forest
-      //8: Boreal Forest
-      else if(depthMap[cell]<=1300){
-        if(depthMap[cell]<=1100){
-          biomeMap[cell] = 7;
-        }
-        else {
-          biomeMap[cell] = 8;
-        }
-        if(climate.AvgRainMap[cell]<0.001 && i+rand()%4-2 > 5 && i+rand()%4-2 < 95 && j+rand()%4-2 > 5 && j+rand()%4-2 < 95){
-          biomeMap[cell] = 6;
-        }
-      }
-      else if(depthMap[cell]<=1500){
-        biomeMap[cell] = 9;
-      }
-      //Otherwise just Temperate Forest
-      else{
-        biomeMap[cell] = 10;
-      }
+  ScopedTimer timer(PROFILE_GENBIOME);
+  //Every Tile is reclassified
+  const size_t gridSizeSq = gridSize*gridSize;
+  for(size_t cell = 0; cell<gridSizeSq; cell++){
+    markDirty(cell);
+  }
+  updateBiome(climate);
+}
+
+/*
+Determine the Surface Biome:
+0: Water
+1: Sandy Beach
+2: Gravel Beach
+3: Stone Beach Cliffs
+4: Wet Plains (Grassland)
+5: Dry Plains (Shrubland)
+6: Rocky Hills
+7: Tempererate Forest
+8: Boreal Forest
+9: Mountain Tundra
+10: Mountain Peak
+
+Compare the Parameters and decide what kind of ground we have.
+Height Classes: Water, Sandy, Gravel, Stony Beach, Plains, Temperate, Boreal, Tundra, Peak
+Rain Classes: Dry (<0.001), Medium, Wet (>=0.02)
+*/
+const int biomeTable[9][3] = {
+  {0, 0, 0},
+  {1, 1, 1},
+  {2, 2, 2},
+  {3, 3, 3},
+  {5, 5, 4},
+  {7, 7, 7},
+  {8, 8, 8},
+  {9, 9, 9},
+  {10, 10, 10}
+};
+//Dry Forest turns into Rocky Hills away from the Border
+const bool rockyTable[9][3] = {
+  {0, 0, 0},
+  {0, 0, 0},
+  {0, 0, 0},
+  {0, 0, 0},
+  {0, 0, 0},
+  {1, 0, 0},
+  {1, 0, 0},
+  {0, 0, 0},
+  {0, 0, 0}
+};
+
+int Terrain::depthClass(float depth){
+  return (depth>200)+(depth>204)+(depth>=210)+(depth>220)+(depth>600)+(depth>1100)+(depth>1300)+(depth>1500);
+}
+
+int Terrain::rainClass(float rain){
+  return (rain>=0.001)+(rain>=0.02);
+}
+
+int Terrain::classifyBiome(size_t cell, int h, float rain) const {
+  const int r = rainClass(rain);
+
+  //Per Tile Jitter of the Border, independent of the Order Tiles are visited in
+  const uint32_t hash = cellRandom(seed, RANDOM_BIOME, cell);
+  const int i = (int)(cell/gridSize);
+  const int j = (int)(cell%gridSize);
+  const bool inside = (i+(int)(hash&3)-2 > 5) & (i+(int)((hash>>2)&3)-2 < 95) &
+                      (j+(int)((hash>>4)&3)-2 > 5) & (j+(int)((hash>>6)&3)-2 < 95);
+
+  const int base = biomeTable[h][r];
+  return (rockyTable[h][r] & inside) ? 6 : base;
+}
+
+void Terrain::markDirty(size_t cell){
+  if(dirtyMap[cell]) return;
+  dirtyMap[cell] = 1;
+  dirtyCells.push_back(cell);
+}
+
+void Terrain::updateBiome(const Climate& climate){
+  changedCells.clear();
+  nextBiome.resize(dirtyCells.size());
+  parallelRanges(dirtyCells.size(), 4096, [&](size_t n0, size_t n1){
+    for(size_t n = n0; n<n1; n++){
+      const size_t cell = dirtyCells[n];
+      nextBiome[n] = classifyBiome(cell, heightClassMap[cell], climate.AvgRainMap[cell]);
+    }
+  });
+  for(size_t n = 0; n<dirtyCells.size(); n++){
+    const size_t cell = dirtyCells[n];
+    dirtyMap[cell] = 0;
+    if(nextBiome[n] != biomeMap[cell]){
+      biomeMap[cell] = nextBiome[n];
+      changedCells.push_back(cell);
     }
   }
+  dirtyCells.clear();
+  if(!changedCells.empty()){
+    revision++;
+    changedRevision = revision;
+  }
 }
 
-void Terrain::erode(int seed, const Terrain* terrain, int years){
+void Terrain::erode(int seed, const Terrain* terrain, int years, Climate* average, Climate* simulation){
+  ScopedTimer timer(PROFILE_ERODE);
   //Climate Simulation
-  Climate* average = new Climate(gridSize);
+  Climate* temporary = average == nullptr ? new Climate(gridSize) : nullptr;
+  if(average == nullptr) average = temporary;
 
   //Simulate the Years
   for(int i = 0; i<years; i++){
@@ -258,58 +659,61 @@ void Terrain::erode(int seed, const Terrain* terrain, int years){
     average->init(0, seed, terrain);
 
     //Simulate 1 Year for Average Weather Conditions
-    average->calcAverage(seed, terrain);
-
-    //Add Erosion of the Climate after 1 Year
-    float erosion = 0;
-    for(size_t j = 0; j<gridSize; j++){
-      for(size_t k=0; k<gridSize; k++){
-        const size_t cell = j*gridSize+k;
-        erosion = (average->AvgRainMap[cell] + 0.5*average->AvgWindMap[cell]);
-        depthMap[cell] = depthMap[cell] - 5*(depthMap[cell]/2000) * (1-depthMap[cell]/2000)*erosion;
+    average->calcAverage(seed, terrain, simulation);
+
+    //Route the Year's Rain downhill
+    calcFlow(average->AvgRainMap);
+
+    //Add Erosion of the Climate after 1 Year, stronger where Water collects
+    parallelRanges(gridSize, 0, [&](size_t j0, size_t j1){
+      for(size_t j = j0; j<j1; j++){
+        for(size_t k=0; k<gridSize; k++){
+          const size_t cell = j*gridSize+k;
+          const float flow = log(1+dischargeMap[cell]/riverThreshold);
+          const float erosion = (average->AvgRainMap[cell] + 0.5*average->AvgWindMap[cell])*(1+flow);
+          depthMap[cell] = depthMap[cell] - 5*(depthMap[cell]/2000) * (1-depthMap[cell]/2000)*erosion;
+          //Rivers carve their Bed
+          if(riverMap[cell]) depthMap[cell] -= 2*flow;
+        }
       }
+    });
+    //Dirty List in Cell Order
+    for(size_t cell = 0; cell<gridSize*gridSize; cell++){
+      if(depthClass(depthMap[cell]) != heightClassMap[cell]) markDirty(cell);
     }
+    calcFields();
+    revision++;
+  }
+  delete temporary;
+}
+
+Climate::Climate(size_t gridSizeIn, GridArena* arena, const char* subsystem) : gridSize(gridSizeIn) {
+  const size_t gridSizeSq = gridSize*gridSize;
+  if(arena == nullptr){
+    storage.reserve(storageBytes(gridSize));
+    arena = &storage;
   }
-  delete average;
+  //Layers start zeroed
+  TempMap     = arena->layer<float>(gridSizeSq, subsystem);
+  HumidityMap = arena->layer<float>(gridSizeSq, subsystem);
+  CloudMap    = arena->layer<bool >(gridSizeSq, subsystem);
+  RainMap     = arena->layer<bool >(gridSizeSq, subsystem);
+  WindMap     = arena->layer<float>(gridSizeSq, subsystem);
+
+  AvgRainMap     = arena->layer<float>(gridSizeSq, subsystem);
+  AvgWindMap     = arena->layer<float>(gridSizeSq, subsystem);
+  AvgCloudMap    = arena->layer<float>(gridSizeSq, subsystem);
+  AvgTempMap     = arena->layer<float>(gridSizeSq, subsystem);
+  AvgHumidityMap = arena->layer<float>(gridSizeSq, subsystem);
+
+  oldMap      = arena->layer<float>(gridSizeSq, subsystem);
+  oldCloudMap = arena->layer<bool >(gridSizeSq, subsystem);
+  oldRainMap  = arena->layer<bool >(gridSizeSq, subsystem);
 }
 
-Climate::Climate(size_t gridSizeIn) : gridSize(gridSizeIn) {
+size_t Climate::storageBytes(size_t gridSize){
   const size_t gridSizeSq = gridSize*gridSize;
-  TempMap     = new float[gridSizeSq];
-  HumidityMap = new float[gridSizeSq];
-  CloudMap    = new bool [gridSizeSq];
-  RainMap     = new bool [gridSizeSq];
-  WindMap     = new float[gridSizeSq];
-
-  AvgRainMap     = new float[gridSizeSq];
-  AvgWindMap     = new float[gridSizeSq];
-  AvgCloudMap    = new float[gridSizeSq];
-  AvgTempMap     = new float[gridSizeSq];
-  AvgHumidityMap = new float[gridSizeSq];
-
-  memset(TempMap       ,0, sizeof(float)*gridSizeSq);
-  memset(HumidityMap   ,0, sizeof(float)*gridSizeSq);
-  memset(WindMap       ,0, sizeof(float)*gridSizeSq);
-
-  memset(AvgRainMap    ,0, sizeof(float)*gridSizeSq);
-  memset(AvgWindMap    ,0, sizeof(float)*gridSizeSq);
-  memset(AvgCloudMap   ,0, sizeof(float)*gridSizeSq);
-  memset(AvgTempMap    ,0, sizeof(float)*gridSizeSq);
-  memset(AvgHumidityMap,0, sizeof(float)*gridSizeSq);
-}
-
-Climate::~Climate(){
-  delete TempMap;
-  delete HumidityMap;
-  delete CloudMap;
-  delete RainMap;
-  delete WindMap;
-
-  delete AvgRainMap;
-  delete AvgWindMap;
-  delete AvgCloudMap;
-  delete AvgTempMap;
-  delete AvgHumidityMap;
+  return 9*GridArena::bytes<float>(gridSizeSq)+4*GridArena::bytes<bool>(gridSizeSq);
 }
 
 void Climate::init(int day, int seed, const Terrain* terrain){
@@ -318,24 +722,81 @@ void Climate::init(int day, int seed, const Terrain* terrain){
   initHumidityMap(terrain);
   initRainMap();
   initCloudMap();
+  revision++;
+}
+
+void Climate::step(int day, int seed, const Terrain* terrain){
+  ScopedTimer timer(PROFILE_CLIMATEDAY);
+  calcWind(day, seed, terrain);
+  calcTempMap(terrain);
+  calcHumidityMap(terrain);
+  calcDownfallMap();
+  revision++;
 }
 
-void Climate::calcAverage(int seed, const Terrain* terrain){
+void Climate::updateAverage(int window, Terrain* terrain){
+  const float w = 1.0f/window;
+  //Bands of Rows on the Pool, their Lists are marked in Band Order so the Dirty List stays in Cell Order
+  const size_t bands = gridSize < parallelMinRows ? 1 : workers().size();
+  rainShifted.resize(bands);
+  parallelRanges(bands, 0, [&](size_t b0, size_t b1){
+    for(size_t b = b0; b<b1; b++){
+      std::vector<size_t>& shifted = rainShifted[b];
+      shifted.clear();
+      const size_t end = gridSize*(b+1)/bands*gridSize;
+      for(size_t cell = gridSize*b/bands*gridSize; cell<end; cell++){
+        AvgWindMap[cell] += (WindMap[cell]-AvgWindMap[cell])*w;
+        AvgCloudMap[cell] += (CloudMap[cell]-AvgCloudMap[cell])*w;
+        AvgTempMap[cell] += (TempMap[cell]-AvgTempMap[cell])*w;
+        AvgHumidityMap[cell] += (HumidityMap[cell]-AvgHumidityMap[cell])*w;
+
+        //Only the Rain Class feeds into the Biome
+        const float rain = AvgRainMap[cell]+(RainMap[cell]-AvgRainMap[cell])*w;
+        if(Terrain::rainClass(rain) != Terrain::rainClass(AvgRainMap[cell])) shifted.push_back(cell);
+        AvgRainMap[cell] = rain;
+      }
+    }
+  });
+  for(size_t b = 0; b<bands; b++)
+    for(size_t n = 0; n<rainShifted[b].size(); n++) terrain->markDirty(rainShifted[b][n]);
+  revision++;
+}
+
+void Climate::calcAverage(int seed, const Terrain* terrain, Climate* simulation){
+  ScopedTimer timer(PROFILE_CALCAVERAGE);
   //Climate Simulation over n years
   int years = 1;
   int startDay = 0;
 
   //Initiate Simulation at a starting point
-  Climate* simulation = new Climate(gridSize);
+  Climate* temporary = simulation == nullptr ? new Climate(gridSize) : nullptr;
+  if(simulation == nullptr) simulation = temporary;
   simulation->init(startDay, seed, terrain);
+  Climatology* season = climatology != nullptr && climatology->periods > 0 ? climatology : nullptr;
+  if(season != nullptr){
+    season->restart();
+    season->revision++;
+  }
+
+  if(climatePrecision() == PRECISION_FIXED16){
+    calcAverageFixed(seed, terrain, simulation, years*365);
+    delete temporary;
+    revision++;
+    return;
+  }
+
+  //Large Grids advance several Days per Sweep, with the same Result
+  if(gridSize >= blockedMinGrid){
+    simulation->stepBlocked(0, years*365, seed, terrain, this);
+    delete temporary;
+    revision++;
+    return;
+  }
 
   //Simulate every day for n years
   for(int i = 0; i<years*365; i++){
     //Calculate new Climate
-    simulation->calcWind(i, seed, terrain);
-    simulation->calcTempMap(terrain);
-    simulation->calcHumidityMap(terrain);
-    simulation->calcDownfallMap();
+    simulation->step(i, seed, terrain);
 
     //Average
     for(size_t j = 0; j<gridSize; j++){
@@ -347,50 +808,261 @@ void Climate::calcAverage(int seed, const Terrain* terrain){
         AvgTempMap[cell] = (AvgTempMap[cell]*i+simulation->TempMap[cell])/(i+1);
         AvgHumidityMap[cell] = (AvgHumidityMap[cell]*i+simulation->HumidityMap[cell])/(i+1);
       }
+      //The Row is still in Cache
+      if(season != nullptr)
+        accumulateSeason(season, i, j*gridSize, j*gridSize+gridSize-1, simulation->WindMap, simulation->RainMap,
+                         simulation->CloudMap, simulation->TempMap, simulation->HumidityMap);
     }
   }
-  delete simulation;
+  delete temporary;
+  revision++;
+}
+
+void Climate::calcAverageFixed(int seed, const Terrain* terrain, const Climate* start, int days){
+  FixedClimate simulation(gridSize);
+  simulation.load(start->TempMap, start->HumidityMap, start->WindMap, start->CloudMap, start->RainMap, terrain->sunMap);
+  const WindSchedule& schedule = WindSchedule::get(seed, cellSize);
+  Climatology* season = climatology != nullptr && climatology->periods > 0 ? climatology : nullptr;
+  for(int i = 0; i<days; i++){
+    simulation.step(schedule.at(i), terrain->depthMap, terrain->seaMap);
+    const int closing = season != nullptr ? season->closing(i) : -1;
+    parallelRanges(gridSize, parallelMinRows, [&](size_t j0, size_t j1){
+      for(size_t cell = j0*gridSize; cell<j1*gridSize; cell++){
+        AvgWindMap[cell] = (AvgWindMap[cell]*i+fromFixedWind(simulation.wind[cell]))/(i+1);
+        AvgRainMap[cell] = (AvgRainMap[cell]*i+simulation.rain[cell])/(i+1);
+        AvgCloudMap[cell] = (AvgCloudMap[cell]*i+simulation.cloud[cell])/(i+1);
+        AvgTempMap[cell] = (AvgTempMap[cell]*i+fromFixed(simulation.temp[cell]))/(i+1);
+        AvgHumidityMap[cell] = (AvgHumidityMap[cell]*i+fromFixed(simulation.humidity[cell]))/(i+1);
+        if(season == nullptr) continue;
+        season->add(cell, fromFixedWind(simulation.wind[cell]), simulation.rain[cell], simulation.cloud[cell],
+                    fromFixed(simulation.temp[cell]), fromFixed(simulation.humidity[cell]));
+        if(closing >= 0) season->close(cell, closing);
+      }
+    });
+  }
 }
 
-Terrain::Terrain(size_t gridSizeIn) : gridSize(gridSizeIn){
+void Climate::stepBlocked(int firstDay, int days, int seed, const Terrain* terrain, Climate* average){
   const size_t gridSizeSq = gridSize*gridSize;
-  depthMap = new float[gridSizeSq];
-  biomeMap = new int[gridSizeSq];
-  localMap = new float[localGrid*localGrid];
+  const size_t dayBytes = gridSizeSq*(3*sizeof(float)+2*sizeof(bool));
+  const int inFlight = std::max(2, std::min(blockedDays, (int)(blockedBytes/dayBytes)));
+
+  //One Set of Maps per Day in Flight plus Yesterday, Set 0 starts as the current State
+  struct DayMaps {
+    float* temp;
+    float* humidity;
+    float* wind;
+    bool* cloud;
+    bool* rain;
+  };
+  std::vector<DayMaps> sets(inFlight+1);
+  GridArena flight((inFlight+1)*(3*GridArena::bytes<float>(gridSizeSq)+2*GridArena::bytes<bool>(gridSizeSq)));
+  for(size_t s = 0; s<sets.size(); s++){
+    sets[s].temp = flight.layer<float>(gridSizeSq, "blocked days");
+    sets[s].humidity = flight.layer<float>(gridSizeSq, "blocked days");
+    sets[s].wind = flight.layer<float>(gridSizeSq, "blocked days");
+    sets[s].cloud = flight.layer<bool>(gridSizeSq, "blocked days");
+    sets[s].rain = flight.layer<bool>(gridSizeSq, "blocked days");
+  }
+  memcpy(sets[0].temp, TempMap, gridSizeSq*sizeof(float));
+  memcpy(sets[0].humidity, HumidityMap, gridSizeSq*sizeof(float));
+  memcpy(sets[0].wind, WindMap, gridSizeSq*sizeof(float));
+  memcpy(sets[0].cloud, CloudMap, gridSizeSq*sizeof(bool));
+  memcpy(sets[0].rain, RainMap, gridSizeSq*sizeof(bool));
+
+  //Strongest possible Wind, bounds how far a Day reaches into Yesterday's Rows
+  const float* depth = terrain->depthMap;
+  const float lo = *std::min_element(depth, depth+gridSizeSq);
+  const float hi = *std::max_element(depth, depth+gridSizeSq);
+  const double maxWind = 5*(1+(hi-lo)/1000);
+
+  if(windSchedule == nullptr || windSeed != seed){
+    windSchedule = &WindSchedule::get(seed, cellSize);
+    windSeed = seed;
+  }
+
+  size_t current = 0;
+  for(int block = 0; block<days; block += inFlight){
+    const int count = std::min(inFlight, days-block);
+    std::vector<DayArgs> args(count);
+    size_t reach = 1;
+    for(int k = 0; k<count; k++){
+      const WindDay wind = windSchedule->at(firstDay+block+k);
+      const DayMaps& old = sets[(current+k)%sets.size()];
+      const DayMaps& cur = sets[(current+k+1)%sets.size()];
+      KernelArgs a;
+      a.gridSize = gridSize;
+      a.temp = cur.temp;
+      a.humidity = cur.humidity;
+      a.wind = cur.wind;
+      a.cloud = old.cloud;
+      a.rain = old.rain;
+      a.depth = terrain->depthMap;
+      a.sea = terrain->seaMap;
+      a.sun = terrain->sunMap;
+      a.windDirection[0] = wind.direction[0];
+      a.windDirection[1] = wind.direction[1];
+      a.windOffset[0] = wind.offset[0];
+      a.windOffset[1] = wind.offset[1];
+
+      DayArgs& d = args[k];
+      d.gridSize = gridSize;
+      d.temp = a;
+      d.temp.oldMap = old.temp;
+      d.humidity = a;
+      d.humidity.oldMap = old.humidity;
+      d.downfall = a;
+      d.downfall.cloud = cur.cloud;
+      d.downfall.rain = cur.rain;
+      d.downfall.oldCloud = old.cloud;
+      d.downfall.oldRain = old.rain;
+      if(average != nullptr){
+        d.avg[0] = average->AvgWindMap;
+        d.avg[1] = average->AvgRainMap;
+        d.avg[2] = average->AvgCloudMap;
+        d.avg[3] = average->AvgTempMap;
+        d.avg[4] = average->AvgHumidityMap;
+        d.avgDay = block+k;
+        if(average->climatology != nullptr && average->climatology->periods > 0) d.season = average->climatology;
+      }
+      reach = std::max(reach, (size_t)ceil(2*maxWind*fabs(wind.direction[0]))+1);
+    }
+
+    //Day k works on Band step-2k: the Day before is always a full Band further,
+    //and the Bands being written in one Step are independent
+    const size_t band = std::max(reach, (size_t)8);
+    const size_t bands = (gridSize+band-1)/band;
+    for(size_t step = 0; step<bands+2*(count-1); step++){
+      parallelRanges(count, 2, [&](size_t k0, size_t k1){
+        for(size_t k = k0; k<k1; k++){
+          if(step < 2*k || step-2*k >= bands) continue;
+          DayArgs d = args[k];
+          d.i0 = (step-2*k)*band;
+          d.i1 = std::min(gridSize, d.i0+band);
+          dispatchGrid<DayKernel>(d);
+        }
+      });
+    }
+    current = (current+count)%sets.size();
+    WindDirection[0] = args[count-1].temp.windDirection[0];
+    WindDirection[1] = args[count-1].temp.windDirection[1];
+    windOffset[0] = args[count-1].temp.windOffset[0];
+    windOffset[1] = args[count-1].temp.windOffset[1];
+  }
+
+  memcpy(TempMap, sets[current].temp, gridSizeSq*sizeof(float));
+  memcpy(HumidityMap, sets[current].humidity, gridSizeSq*sizeof(float));
+  memcpy(WindMap, sets[current].wind, gridSizeSq*sizeof(float));
+  memcpy(CloudMap, sets[current].cloud, gridSizeSq*sizeof(bool));
+  memcpy(RainMap, sets[current].rain, gridSizeSq*sizeof(bool));
+  revision += days;
 }
 
-Terrain::~Terrain(){
-  delete depthMap;
-  delete biomeMap;
+Terrain::Terrain(size_t gridSizeIn, GridArena* arena) : gridSize(gridSizeIn){
+  const size_t gridSizeSq = gridSize*gridSize;
+  if(arena == nullptr){
+    storage.reserve(storageBytes(gridSize));
+    arena = &storage;
+  }
+  depthMap = arena->layer<float>(gridSizeSq, "terrain");
+  biomeMap = arena->layer<int>(gridSizeSq, "terrain");
+  dirtyMap = arena->layer<unsigned char>(gridSizeSq, "terrain");
+  seaMap = arena->layer<unsigned char>(gridSizeSq, "terrain");
+  sunMap = arena->layer<float>(gridSizeSq, "terrain");
+  heightClassMap = arena->layer<unsigned char>(gridSizeSq, "terrain");
+  flowMap = arena->layer<unsigned char>(gridSizeSq, "terrain");
+  dischargeMap = arena->layer<float>(gridSizeSq, "terrain");
+  riverMap = arena->layer<unsigned char>(gridSizeSq, "terrain");
+  memset(flowMap, flowNone, gridSizeSq);
+  //No Biome yet, so the first Classification reports every Tile
+  memset(biomeMap, 0xff, sizeof(int)*gridSizeSq);
+  localMap = arena->layer<float>(localGrid*localGrid, "terrain");
+}
+
+size_t Terrain::storageBytes(size_t gridSize){
+  const size_t gridSizeSq = gridSize*gridSize;
+  return 3*GridArena::bytes<float>(gridSizeSq)+GridArena::bytes<int>(gridSizeSq)
+        +5*GridArena::bytes<unsigned char>(gridSizeSq)+GridArena::bytes<float>(localGrid*localGrid);
+}
+
+void Terrain::calcFlow(const float* rain){
+  ScopedTimer timer(PROFILE_CALCFLOW);
+  priorityFlood(gridSize, depthMap, seaMap, flowMap, flowOrder);
+
+  //Every Tile's own Rain, scaled to the Area of a Tile on the default Grid
+  const size_t gridSizeSq = gridSize*gridSize;
+  const float area = (float)(gridSizeDefault*gridSizeDefault)/gridSizeSq;
+  for(size_t cell = 0; cell<gridSizeSq; cell++) dischargeMap[cell] = rain[cell]*area;
+
+  //Upstream first, every Tile passes its Water on to its Receiver
+  for(size_t n = flowOrder.size(); n-->0;){
+    const uint32_t cell = flowOrder[n];
+    const unsigned char d = flowMap[cell];
+    if(d == flowNone) continue;
+    dischargeMap[cell+flowDi[d]*(long)gridSize+flowDj[d]] += dischargeMap[cell];
+  }
+
+  for(size_t cell = 0; cell<gridSizeSq; cell++)
+    riverMap[cell] = !seaMap[cell] && dischargeMap[cell] >= riverThreshold;
+  revision++;
+}
+
+void Terrain::calcFields(){
+  parallelRanges(gridSize*gridSize, 0, [&](size_t c0, size_t c1){
+    for(size_t cell = c0; cell<c1; cell++){
+      const float depth = depthMap[cell];
+      //Water Surface for Evaporation
+      seaMap[cell] = depth<=200;
+      //Sunlight Heating of a clear Tile
+      sunMap[cell] = (1-depth/2000)*0.008;
+      heightClassMap[cell] = depthClass(depth);
+    }
+  });
 }
 
 void Terrain::genDepth(int seed){
+  ScopedTimer timer(PROFILE_GENDEPTH);
   //Perlin Noise Module
 
   //Global Depth Map is Fine, unaffected by rivers.
   module::Perlin perlin = {};
+  depthNoise(perlin);
+  this->seed = seed;
+
+  //Generate the Perlin Noise World Map, Rows are independent
+  parallelRanges(gridSize, 0, [&](size_t i0, size_t i1){
+    for(size_t i = i0; i<i1; i++){
+      for(size_t j = 0; j<gridSize; j++){
+        depthMap[i*gridSize+j] = noiseDepth(perlin, i, j);
+      }
+    }
+  });
+  calcFields();
+  revision++;
+}
 
+void Terrain::depthNoise(module::Perlin& perlin){
   perlin.SetOctaveCount(12);
   perlin.SetFrequency(2);
   perlin.SetPersistence(0.6);
+}
 
-  //Generate the Perlin Noise World Map
-  for(size_t i = 0; i<gridSize; i++){
-    for(size_t j = 0; j<gridSize; j++){
-      const size_t cell = i*gridSize+j;
-
-      //Generate the Height Map with Perlin Noise
-      float x = (float)i / gridSize;
-      float y = (float)j / gridSize;
-      depthMap[cell] = (perlin.GetValue(x, y, seed))/5+0.25;
+float Terrain::noiseDepth(const module::Perlin& perlin, float i, float j) const {
+  //Generate the Height Map with Perlin Noise
+  float x = i / gridSize;
+  float y = j / gridSize;
+  float depth = (perlin.GetValue(x, y, seed))/5+0.25;
 
-      //Multiply with the Height Factor
-      depthMap[cell] *= worldDepth;
-    }
-  }
+  //Multiply with the Height Factor
+  return depth*worldDepth;
 }
 
 void Terrain::genLocal(int seed, const Player* player){
+  genLocal(seed, player->xTotal, player->yTotal, localMap);
+}
+
+void Terrain::genLocal(int seed, int xTotal, int yTotal, float* out) const {
+  ScopedTimer timer(PROFILE_GENLOCAL);
   //Perlin Noise Module
   module::Perlin perlin = {};
 
@@ -402,43 +1074,30 @@ void Terrain::genLocal(int seed, const Player* player){
   for(int i = 0; i<localGrid; i++){
     for(int j = 0; j<localGrid; j++){
       //Generate the Height Map with Perlin Noise
-      float x = float(player->xTotal-localGrid/2+i)/100000.0f;
-      float y = float(player->yTotal-localGrid/2+j)/100000.0f;
+      float x = float(xTotal-localGrid/2+i)/100000.0f;
+      float y = float(yTotal-localGrid/2+j)/100000.0f;
       const size_t currLocalCell = i*localGrid+j;
-      localMap[currLocalCell] = (perlin.GetValue(x, y, seed))/5+0.25;
+      out[currLocalCell] = (perlin.GetValue(x, y, seed))/5+0.25;
       //Multiply with the Height Factor
-      localMap[currLocalCell] = localMap[currLocalCell]*worldDepth;
+      out[currLocalCell] = out[currLocalCell]*worldDepth;
     }
   }
 }
 
 void Climate::calcWind(int day, int seed, const Terrain* terrain){
-  //Perlin Noise Module
-
-  module::Perlin perlin = {};
-  perlin.SetOctaveCount(2);
-  perlin.SetFrequency(4);
-
-  float timeInterval = (float)day/365;
-
-  //winddirection shifts every Day
-  //One Dimensional Perlin Noise
-  WindDirection[0] = (perlin.GetValue(timeInterval, seed, seed));
-  WindDirection[1] = (perlin.GetValue(timeInterval, seed+timeInterval, seed));
-
-  for(size_t i=0; i<gridSize; i++){
-    for(size_t j=0; j<gridSize; j++){
-      //Previous Tiles
-      size_t k = i+cellSize*(WindDirection[0]);
-      if(k > gridSize-1){k = i;};
-      size_t l = j+cellSize*(WindDirection[1]);
-      if(l > gridSize-1){l = j;};
-
-      const size_t cell = i*gridSize+j;
-      const size_t fromCell = k*gridSize+l;
-      WindMap[cell]=5*(1-(terrain->depthMap[cell]-terrain->depthMap[fromCell])/1000);
-    }
+  ScopedTimer timer(PROFILE_CALCWIND);
+  //winddirection shifts every Day, looked up from the shared Schedule
+  if(windSchedule == nullptr || windSeed != seed){
+    windSchedule = &WindSchedule::get(seed, cellSize);
+    windSeed = seed;
   }
+  const WindDay wind = windSchedule->at(day);
+  WindDirection[0] = wind.direction[0];
+  WindDirection[1] = wind.direction[1];
+  windOffset[0] = wind.offset[0];
+  windOffset[1] = wind.offset[1];
+
+  dispatchGrid<WindKernel>(kernelArgs(terrain));
 }
 
 void Climate::initTempMap(const Terrain* terrain){
@@ -490,149 +1149,44 @@ void Climate::initRainMap(){
 }
 
 void Climate::calcHumidityMap(const Terrain* terrain){
-  const size_t gridSizeSq = gridSize*gridSize;
-  float* oldHumidMap = new float[gridSizeSq];
-  memcpy(oldHumidMap,HumidityMap,gridSizeSq*sizeof(float));
-
-  for(size_t i=1; i<gridSize-1; i++){
-    for(size_t j=1; j<gridSize-1; j++){
-      const size_t cell = i*gridSize+j;
-      const size_t prevRow  = (i-1)*gridSize;
-      const size_t nextRow  = (i+1)*gridSize;
-
-      //Get New Map from Wind Direction
-      //Indices of Previous Tile
-      //Assumption: Wind Blows Despite Obstacles
-      size_t k = i+2*WindMap[cell]*(WindDirection[0]);
-      if(k > gridSize-1){k = i;};
-      size_t l = j+2*WindMap[cell]*(WindDirection[1]);
-      if(l > gridSize-1){l = j;};
-
-      const size_t fromCell = k*gridSize+l;
-      
-      //Transfer to New Tile
-      HumidityMap[cell]=oldHumidMap[fromCell];
-
-      //Average (with all surrounding cells)
-      HumidityMap[cell] = 
-        (HumidityMap[prevRow+j-1]+HumidityMap[prevRow+j]+HumidityMap[prevRow+j+1]+
-         HumidityMap[cell -1]+HumidityMap[cell] +HumidityMap[cell+1] +
-         HumidityMap[nextRow+j-1]+HumidityMap[nextRow+j]+HumidityMap[nextRow+j+1]
-        )/9;
-
-      //We are over a body of water, temperature accelerates
-      float addHumidity=0;
-      if(CloudMap[cell]==0){
-        addHumidity=0.01;
-        if(terrain->depthMap[cell]<=200){
-          addHumidity = 0.05*TempMap[cell];
-        }
-      }
-
-      //Raining
-      float addRain=0;
-      if(RainMap[cell]==1){
-        addRain = -(HumidityMap[cell])*0.8;
-      }
-
-      HumidityMap[cell]+=(HumidityMap[cell])*addRain+(1-HumidityMap[cell])*(addHumidity);
-      if(HumidityMap[cell]>1){HumidityMap[cell]=1;}
-      if(HumidityMap[cell]<0){HumidityMap[cell]=0;}
-    }
-  }
-  delete oldHumidMap;
+  ScopedTimer timer(PROFILE_CALCHUMIDITY);
+  memcpy(oldMap,HumidityMap,gridSize*gridSize*sizeof(float));
+  dispatchGrid<HumidityKernel>(kernelArgs(terrain));
 }
 
 void Climate::calcTempMap(const Terrain* terrain){
-  const size_t gridSizeSq = gridSize*gridSize;
-  float* oldTempMap = new float[gridSizeSq];
-  memcpy(oldTempMap,TempMap,gridSizeSq*sizeof(float));
-
-  for(size_t i=1; i<gridSize-1; i++){
-    for(size_t j=1; j<gridSize-1; j++){
-      const size_t cell = i*gridSize+j;
-      
-      //Get New Map from Wind Direction
-      //Indices of Previous Tile
-      size_t k = i+2*WindMap[cell]*(WindDirection[0]);
-      if(k > gridSize-1){k = i;};
-      size_t l = j+2*WindMap[cell]*(WindDirection[1]);
-      if(l > gridSize-1){l = j;};
-
-      const size_t fromCell = k*gridSize+l;
-
-      //Transfer to New Tile
-      TempMap[cell]=oldTempMap[fromCell];
-
-      //Average (from corners to this cell)
-      TempMap[cell] = (TempMap[(i-1)*gridSize+j-1]+TempMap[(i+1)*gridSize+j-1]+TempMap[(i+1)*gridSize+j+1]+TempMap[(i-1)*gridSize+j+1])/4;
-
-      //Various Contributions to the TempMap
-      //Rising Air Cools
-
-      float addCool = 0.5*(WindMap[cell]-5);
-
-
-      //Sunlight on Surface
-      float addSun = 0;
-      if(CloudMap[cell]==0){
-        addSun = (1-terrain->depthMap[cell]/2000)*0.008;
-      }
-
-      float addRain = 0;
-      if(RainMap[cell]==1 && TempMap[cell]>0){
-        //Rain Reduces Temperature
-        addRain = -0.01;
-      }
-
-      //Add Contributions
-
-      TempMap[cell]+=0.8*(1-TempMap[cell])*(addSun)+0.6*(TempMap[cell])*(addRain+addCool);
-      if(TempMap[cell]>1){TempMap[cell]=1;}
-      if(TempMap[cell]<0){TempMap[cell]=0;}
-    }
-  }
-  delete oldTempMap;
+  ScopedTimer timer(PROFILE_CALCTEMP);
+  memcpy(oldMap,TempMap,gridSize*gridSize*sizeof(float));
+  dispatchGrid<TempKernel>(kernelArgs(terrain));
 }
 
 void Climate::calcDownfallMap(){
+  ScopedTimer timer(PROFILE_CALCDOWNFALL);
   const size_t gridSizeSq = gridSize*gridSize;
-  float* oldCloudMap = new float[gridSizeSq];
-  float* oldRainMap  = new float[gridSizeSq];
-  memcpy(oldRainMap ,RainMap ,gridSizeSq*sizeof(float));
-  memcpy(oldCloudMap,CloudMap,gridSizeSq*sizeof(float));
-  memset(CloudMap,0,gridSizeSq*sizeof(bool));
-  memset(RainMap ,0,gridSizeSq*sizeof(bool));
+  memcpy(oldRainMap ,RainMap ,gridSizeSq*sizeof(bool));
+  memcpy(oldCloudMap,CloudMap,gridSizeSq*sizeof(bool));
+  dispatchGrid<DownfallKernel>(kernelArgs(nullptr));
+}
 
-  for(size_t i=1; i<gridSize-1; i++){
-    for(size_t j=1; j<gridSize-1; j++){
-      const size_t cell = i*gridSize+j;
-      
-      //Old Coordinates
-      size_t k = i+2*WindMap[cell]*(WindDirection[0]);
-      if(k > gridSize-1){k = i;};
-      size_t l = j+2*WindMap[cell]*(WindDirection[1]);
-      if(l > gridSize-1){l = j;};
-      
-      const size_t fromCell = k*gridSize+l;
-      
-      //Transfer to New Tile
-      CloudMap[cell]=oldCloudMap[fromCell];
-      RainMap [cell]=oldRainMap [fromCell];
-
-      //Rain Condition
-      if(HumidityMap[cell]>=0.35+0.5*TempMap[cell]){
-        RainMap[cell]=1;
-      }
-      else if(HumidityMap[cell]>=0.3+0.3*TempMap[cell]){
-        CloudMap[cell]=1;
-      }
-      else{
-        CloudMap[cell]=0;
-        RainMap[cell]=0;
-      }
-    }
+KernelArgs Climate::kernelArgs(const Terrain* terrain) const {
+  KernelArgs a;
+  a.gridSize = gridSize;
+  a.temp = TempMap;
+  a.humidity = HumidityMap;
+  a.wind = WindMap;
+  a.cloud = CloudMap;
+  a.rain = RainMap;
+  a.oldMap = oldMap;
+  a.oldCloud = oldCloudMap;
+  a.oldRain = oldRainMap;
+  if(terrain != nullptr){
+    a.depth = terrain->depthMap;
+    a.sea = terrain->seaMap;
+    a.sun = terrain->sunMap;
   }
-  delete oldCloudMap;
-  delete oldRainMap;
+  a.windDirection[0] = WindDirection[0];
+  a.windDirection[1] = WindDirection[1];
+  a.windOffset[0] = windOffset[0];
+  a.windOffset[1] = windOffset[1];
+  return a;
 }
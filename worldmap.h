@@ -0,0 +1,341 @@
+//World Map for the Simulation View
+//The Biome Map lives in a Mip Pyramid of Textures that is only touched where Biomes change,
+//the Climate Overlays are blended on the CPU for the visible Part of the Level on Screen.
+//Zoom and Pan pick the Level with at least a Pixel per Texel, so the Texels drawn stay bounded by the Screen.
+#include <vector>
+#include <math.h>
+
+//Overlay Layers, in Drawing Order
+enum WorldOverlay {
+  OVERLAY_WIND,
+  OVERLAY_CLOUD,
+  OVERLAY_RAIN,
+  OVERLAY_TEMP,
+  OVERLAY_HUMIDITY,
+  OVERLAY_AVGWIND,
+  OVERLAY_AVGCLOUD,
+  OVERLAY_AVGRAIN,
+  OVERLAY_AVGTEMP,
+  OVERLAY_AVGHUMIDITY,
+  OVERLAY_COUNT
+};
+
+class WorldMap {
+  public:
+  ~WorldMap();
+
+  //Biome Map with every Overlay whose Bit is set in overlays on top, two Copies in total
+  void render(const World* territory, SDL_Renderer* gRenderer, const Player* player, unsigned int overlays);
+  //Mouse Wheel and +/- zoom around the Cursor or the Screen Center, dragging pans, Home shows the whole Grid
+  void handleEvent(const SDL_Event& e);
+  //Map Colors, shared with the Tile Export
+  static SDL_Color biomeColor(int biome, bool river);
+
+  private:
+  //Texel (x, y) of Level k covers the Cells from (x<<k, y<<k), x along i. RGBA per Pixel.
+  struct Level {
+    size_t size = 0;
+    SDL_Texture* base = NULL;
+    SDL_Texture* overlay = NULL;
+    std::vector<Uint8> basePixels;
+    std::vector<Uint8> overlayPixels;
+    //Rows of basePixels not uploaded yet
+    size_t dirtyLo = 0;
+    size_t dirtyHi = 0;
+  };
+  size_t gridSize = 0;
+  std::vector<Level> levels;
+  bool baseValid = false;
+  unsigned int baseRevision = 0;
+  //What the Overlay Texture of overlayLevel holds
+  int overlayLevel = -1;
+  unsigned int overlayRevision = 0;
+  unsigned int overlayMask = 0;
+  SDL_Rect overlayRect = { 0, 0, 0, 0 };
+
+  //Screen Pixels per Cell, and the Cell at the Screen's top left Corner
+  float zoom = 0;
+  float originX = 0;
+  float originY = 0;
+  bool dragging = false;
+  static constexpr float maxZoom = 32;
+
+  bool create(SDL_Renderer* gRenderer, size_t gridSize);
+  void setBase(size_t x, size_t y, SDL_Color c);
+  void downsample(size_t level, size_t x, size_t y);
+  void updateBase(const Terrain& terrain);
+  void composite(const Climate& climate, unsigned int overlays, int level, const SDL_Rect& visible);
+  static SDL_Color overlayColor(const Climate& climate, int layer, size_t cell);
+
+  float fitZoom() const { return (float)SCREEN_WIDTH/gridSize; }
+  void zoomAt(float factor, float screenX, float screenY);
+  void clampView();
+  int pickLevel() const;
+  SDL_Rect visibleTexels(int level) const;
+};
+
+WorldMap::~WorldMap(){
+  for(size_t k = 0; k<levels.size(); k++){
+    if(levels[k].base != NULL) SDL_DestroyTexture(levels[k].base);
+    if(levels[k].overlay != NULL) SDL_DestroyTexture(levels[k].overlay);
+  }
+}
+
+bool WorldMap::create(SDL_Renderer* gRenderer, size_t gridSizeIn){
+  if(!levels.empty() && gridSize == gridSizeIn) return levels.back().overlay != NULL;
+  for(size_t k = 0; k<levels.size(); k++){
+    if(levels[k].base != NULL) SDL_DestroyTexture(levels[k].base);
+    if(levels[k].overlay != NULL) SDL_DestroyTexture(levels[k].overlay);
+  }
+  levels.clear();
+  gridSize = gridSizeIn;
+  zoom = fitZoom();
+  originX = originY = 0;
+
+  //Halve until the whole Grid fits the Screen at a Pixel per Texel
+  size_t size = gridSize;
+  while(true){
+    Level level;
+    level.size = size;
+    level.base = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, size, size);
+    level.overlay = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, size, size);
+    level.basePixels.assign(size*size*4, 255);
+    level.overlayPixels.assign(size*size*4, 0);
+    levels.push_back(level);
+    if(level.base == NULL || level.overlay == NULL) return false;
+    SDL_SetTextureBlendMode(level.overlay, SDL_BLENDMODE_BLEND);
+    if(size <= (size_t)SCREEN_WIDTH || size == 1) break;
+    size = (size+1)/2;
+  }
+  baseValid = false;
+  overlayLevel = -1;
+  return true;
+}
+
+SDL_Color WorldMap::biomeColor(int biome, bool river){
+  //Rivers over Land
+  if(river && biome != 0) return { 0x3b, 0x6e, 0xa5, 255 };
+  switch(biome){
+    //Water
+    case 0: return { 0x2d, 0x56, 0x85, 255 };
+    //Sandy Beach
+    case 1: return { 0xea, 0xdf, 0x9e, 255 };
+    //Gravel Beach
+    case 2: return { 0xcc, 0xcc, 0xcc, 255 };
+    //Stoney Beach Cliff
+    case 3: return { 0xa7, 0xa5, 0x9b, 255 };
+    //Wet Plains (Grassland)
+    case 4: return { 0x9e, 0xc1, 0x6d, 255 };
+    //Dry Plains (Shrubland)
+    case 5: return { 0xbc, 0xc1, 0x6d, 255 };
+    //Rocky Hills
+    case 6: return { 0xaa, 0xaa, 0xaa, 255 };
+    //Temperate Forest
+    case 7: return { 0x3d, 0xab, 0x50, 255 };
+    //Boreal Forest
+    case 8: return { 0x30, 0x7a, 0x3c, 255 };
+    //Mountain Tundra
+    case 9: return { 0x77, 0x77, 0x77, 255 };
+    //Mountain Peak
+    case 10: return { 0xee, 0xee, 0xee, 255 };
+  }
+  return { 0, 0, 0, 255 };
+}
+
+//Clamped Color Channel
+Uint8 channel(float v){
+  return (Uint8)std::min(std::max(v, 0.0f), 255.0f);
+}
+
+SDL_Color WorldMap::overlayColor(const Climate& climate, int layer, size_t cell){
+  switch(layer){
+    case OVERLAY_WIND: return { channel(climate.WindMap[cell]*25), channel(climate.WindMap[cell]*25), channel(climate.WindMap[cell]*25), 100 };
+    case OVERLAY_CLOUD: return { 255, 255, 255, channel(100*climate.CloudMap[cell]) };
+    case OVERLAY_RAIN: return { 255, 255, 255, channel(255*climate.RainMap[cell]) };
+    case OVERLAY_TEMP: return { channel(climate.TempMap[cell]*255), 150, 150, 100 };
+    case OVERLAY_HUMIDITY: return { 50, 50, channel(climate.HumidityMap[cell]*255), 220 };
+    case OVERLAY_AVGWIND: return { 255, 255, 255, channel(((5-climate.AvgWindMap[cell])+2)*60) };
+    case OVERLAY_AVGCLOUD: return { 255, 255, 255, channel(255*climate.AvgCloudMap[cell]) };
+    case OVERLAY_AVGRAIN: return { 255, 255, 255, channel(255*10*climate.AvgRainMap[cell]) };
+    case OVERLAY_AVGTEMP: return { channel(climate.AvgTempMap[cell]*255), 150, 150, 100 };
+    case OVERLAY_AVGHUMIDITY: return { 50, 50, channel(climate.AvgHumidityMap[cell]*255), 220 };
+  }
+  return { 0, 0, 0, 0 };
+}
+
+void WorldMap::setBase(size_t x, size_t y, SDL_Color c){
+  Level& l = levels[0];
+  Uint8* p = &l.basePixels[(y*l.size+x)*4];
+  p[0] = c.r; p[1] = c.g; p[2] = c.b; p[3] = c.a;
+  l.dirtyLo = std::min(l.dirtyLo, y);
+  l.dirtyHi = std::max(l.dirtyHi, y+1);
+}
+
+//Box Filter of the up to four Children
+void WorldMap::downsample(size_t k, size_t x, size_t y){
+  const Level& child = levels[k-1];
+  Level& l = levels[k];
+  const size_t x0 = 2*x, x1 = std::min(2*x+1, child.size-1);
+  const size_t y0 = 2*y, y1 = std::min(2*y+1, child.size-1);
+  const Uint8* c[4] = { &child.basePixels[(y0*child.size+x0)*4], &child.basePixels[(y0*child.size+x1)*4],
+                        &child.basePixels[(y1*child.size+x0)*4], &child.basePixels[(y1*child.size+x1)*4] };
+  Uint8* p = &l.basePixels[(y*l.size+x)*4];
+  for(int ch = 0; ch<4; ch++) p[ch] = (Uint8)((c[0][ch]+c[1][ch]+c[2][ch]+c[3][ch]+2)/4);
+  l.dirtyLo = std::min(l.dirtyLo, y);
+  l.dirtyHi = std::max(l.dirtyHi, y+1);
+}
+
+void WorldMap::updateBase(const Terrain& terrain){
+  ScopedTimer timer(PROFILE_DRAWWORLDMAP);
+  if(!(baseValid && terrain.revision == baseRevision)){
+    //Only the last Classification's Changes if nothing else happened since, carried up the Pyramid
+    const bool incremental = baseValid && terrain.revision == baseRevision+1 && terrain.changedRevision == terrain.revision;
+    if(incremental){
+      for(size_t n = 0; n<terrain.changedCells.size(); n++){
+        const size_t cell = terrain.changedCells[n];
+        size_t x = cell/gridSize, y = cell%gridSize;
+        setBase(x, y, biomeColor(terrain.biomeMap[cell], terrain.riverMap[cell]));
+        for(size_t k = 1; k<levels.size(); k++){
+          x /= 2;
+          y /= 2;
+          downsample(k, x, y);
+        }
+      }
+    }
+    else{
+      for(size_t cell = 0; cell<gridSize*gridSize; cell++)
+        setBase(cell/gridSize, cell%gridSize, biomeColor(terrain.biomeMap[cell], terrain.riverMap[cell]));
+      for(size_t k = 1; k<levels.size(); k++)
+        for(size_t y = 0; y<levels[k].size; y++)
+          for(size_t x = 0; x<levels[k].size; x++) downsample(k, x, y);
+    }
+    baseValid = true;
+    baseRevision = terrain.revision;
+  }
+
+  //Upload the Rows that changed
+  for(size_t k = 0; k<levels.size(); k++){
+    Level& l = levels[k];
+    if(l.dirtyLo >= l.dirtyHi) continue;
+    SDL_Rect rows = { 0, (int)l.dirtyLo, (int)l.size, (int)(l.dirtyHi-l.dirtyLo) };
+    SDL_UpdateTexture(l.base, &rows, &l.basePixels[l.dirtyLo*l.size*4], l.size*4);
+    l.dirtyLo = l.size;
+    l.dirtyHi = 0;
+  }
+}
+
+void WorldMap::composite(const Climate& climate, unsigned int overlays, int k, const SDL_Rect& visible){
+  ScopedTimer timer(PROFILE_DRAWWORLDOVERLAY);
+  const bool sameRect = visible.x == overlayRect.x && visible.y == overlayRect.y && visible.w == overlayRect.w && visible.h == overlayRect.h;
+  if(overlays == overlayMask && climate.revision == overlayRevision && k == overlayLevel && sameRect) return;
+  overlayMask = overlays;
+  overlayRevision = climate.revision;
+  overlayLevel = k;
+  overlayRect = visible;
+
+  //Layers are blended in Order with premultiplied Alpha, then stored straight for SDL's Blending.
+  //A Texel shows the Cell at its Center.
+  Level& l = levels[k];
+  const size_t half = ((size_t)1<<k)/2;
+  for(int y = visible.y; y<visible.y+visible.h; y++){
+    const size_t j = std::min(((size_t)y<<k)+half, gridSize-1);
+    for(int x = visible.x; x<visible.x+visible.w; x++){
+      const size_t i = std::min(((size_t)x<<k)+half, gridSize-1);
+      const size_t cell = i*gridSize+j;
+      float r = 0, g = 0, b = 0, a = 0;
+      for(int layer = 0; layer<OVERLAY_COUNT; layer++){
+        if(!(overlays & (1u<<layer))) continue;
+        const SDL_Color c = overlayColor(climate, layer, cell);
+        const float alpha = c.a/255.0f;
+        r = c.r*alpha+r*(1-alpha);
+        g = c.g*alpha+g*(1-alpha);
+        b = c.b*alpha+b*(1-alpha);
+        a = alpha+a*(1-alpha);
+      }
+      Uint8* p = &l.overlayPixels[((size_t)y*l.size+x)*4];
+      p[0] = a > 0 ? channel(r/a) : 0;
+      p[1] = a > 0 ? channel(g/a) : 0;
+      p[2] = a > 0 ? channel(b/a) : 0;
+      p[3] = channel(a*255);
+    }
+  }
+  SDL_UpdateTexture(l.overlay, &visible, &l.overlayPixels[((size_t)visible.y*l.size+visible.x)*4], l.size*4);
+}
+
+void WorldMap::clampView(){
+  const float spanX = SCREEN_WIDTH/zoom, spanY = SCREEN_HEIGHT/zoom;
+  originX = std::min(std::max(originX, 0.0f), std::max(0.0f, gridSize-spanX));
+  originY = std::min(std::max(originY, 0.0f), std::max(0.0f, gridSize-spanY));
+}
+
+void WorldMap::zoomAt(float factor, float screenX, float screenY){
+  const float cellX = originX+screenX/zoom;
+  const float cellY = originY+screenY/zoom;
+  zoom = std::min(std::max(zoom*factor, fitZoom()), std::max(maxZoom, fitZoom()));
+  //The Cell under the Cursor stays there
+  originX = cellX-screenX/zoom;
+  originY = cellY-screenY/zoom;
+  clampView();
+}
+
+void WorldMap::handleEvent(const SDL_Event& e){
+  if(levels.empty()) return;
+  if(e.type == SDL_MOUSEWHEEL && e.wheel.y != 0){
+    int x, y;
+    SDL_GetMouseState(&x, &y);
+    zoomAt(powf(1.25f, (float)e.wheel.y), (float)x, (float)y);
+  }
+  else if(e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) dragging = true;
+  else if(e.type == SDL_MOUSEBUTTONUP && e.button.button == SDL_BUTTON_LEFT) dragging = false;
+  else if(e.type == SDL_MOUSEMOTION && dragging){
+    originX -= e.motion.xrel/zoom;
+    originY -= e.motion.yrel/zoom;
+    clampView();
+  }
+  else if(e.type == SDL_KEYDOWN){
+    const SDL_Keycode key = e.key.keysym.sym;
+    if(key == SDLK_EQUALS || key == SDLK_PLUS || key == SDLK_KP_PLUS) zoomAt(1.25f, SCREEN_WIDTH/2, SCREEN_HEIGHT/2);
+    else if(key == SDLK_MINUS || key == SDLK_KP_MINUS) zoomAt(0.8f, SCREEN_WIDTH/2, SCREEN_HEIGHT/2);
+    else if(key == SDLK_HOME){
+      zoom = fitZoom();
+      originX = originY = 0;
+    }
+  }
+}
+
+int WorldMap::pickLevel() const {
+  int k = 0;
+  while(k+1 < (int)levels.size() && zoom*(1<<k) < 1) k++;
+  return k;
+}
+
+SDL_Rect WorldMap::visibleTexels(int k) const {
+  const Level& l = levels[k];
+  const float texel = (float)(1<<k);
+  const int x0 = std::max(0, (int)floorf(originX/texel));
+  const int y0 = std::max(0, (int)floorf(originY/texel));
+  const int x1 = std::min((int)l.size, (int)ceilf((originX+SCREEN_WIDTH/zoom)/texel));
+  const int y1 = std::min((int)l.size, (int)ceilf((originY+SCREEN_HEIGHT/zoom)/texel));
+  return { x0, y0, std::max(0, x1-x0), std::max(0, y1-y0) };
+}
+
+void WorldMap::render(const World* territory, SDL_Renderer* gRenderer, const Player* player, unsigned int overlays){
+  if(!create(gRenderer, territory->terrain.gridSize)) return;
+  updateBase(territory->terrain);
+
+  const int k = pickLevel();
+  const SDL_Rect src = visibleTexels(k);
+  const float texel = zoom*(1<<k);
+  const SDL_FRect map = { ((src.x<<k)-originX)*zoom, ((src.y<<k)-originY)*zoom, src.w*texel, src.h*texel };
+  SDL_RenderCopyF(gRenderer, levels[k].base, &src, &map);
+  if(overlays != 0){
+    composite(territory->climate, overlays, k, src);
+    SDL_RenderCopyF(gRenderer, levels[k].overlay, &src, &map);
+  }
+
+  //Player Position, at least a few Pixels wide
+  SDL_SetRenderDrawColor(gRenderer, 0xee, 0x11, 0x11, 255);
+  const float size = std::max(zoom, 3.0f);
+  const SDL_FRect rect = { (player->xGlobal-originX)*zoom, (player->yGlobal-originY)*zoom, size, size };
+  SDL_RenderFillRectF(gRenderer, &rect);
+}